@@ -0,0 +1,188 @@
+// Notices:
+//
+// Copyright 2017 United States Government as represented by the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+//
+// Disclaimers:
+//
+// No Warranty: THE SUBJECT SOFTWARE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY OF ANY KIND, EITHER EXPRESSED,
+// IMPLIED, OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, ANY WARRANTY THAT THE SUBJECT SOFTWARE WILL CONFORM TO SPECIFICATIONS, ANY IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, OR FREEDOM FROM INFRINGEMENT, ANY WARRANTY THAT THE SUBJECT
+// SOFTWARE WILL BE ERROR FREE, OR ANY WARRANTY THAT DOCUMENTATION, IF PROVIDED, WILL CONFORM TO THE SUBJECT SOFTWARE. THIS AGREEMENT DOES NOT, IN ANY MANNER, CONSTITUTE AN ENDORSEMENT BY GOVERNMENT AGENCY OR ANY PRIOR RECIPIENT OF ANY RESULTS, RESULTING DESIGNS,
+// HARDWARE, SOFTWARE PRODUCTS OR ANY OTHER APPLICATIONS RESULTING FROM USE OF THE SUBJECT SOFTWARE.  FURTHER, GOVERNMENT AGENCY DISCLAIMS ALL WARRANTIES AND LIABILITIES REGARDING THIRD-PARTY SOFTWARE, IF PRESENT IN THE ORIGINAL SOFTWARE, AND DISTRIBUTES IT "AS IS."
+//
+// Waiver and Indemnity:  RECIPIENT AGREES TO WAIVE ANY AND ALL CLAIMS AGAINST THE UNITED STATES GOVERNMENT,
+// ITS CONTRACTORS AND SUBCONTRACTORS, AS WELL AS ANY PRIOR RECIPIENT.  IF RECIPIENT'S USE OF THE SUBJECT SOFTWARE RESULTS IN ANY LIABILITIES, DEMANDS, DAMAGES, EXPENSES OR LOSSES ARISING FROM SUCH USE, INCLUDING ANY DAMAGES FROM PRODUCTS BASED ON, OR RESULTING
+// FROM, RECIPIENT'S USE OF THE SUBJECT SOFTWARE, RECIPIENT SHALL INDEMNIFY AND HOLD HARMLESS THE UNITED STATES GOVERNMENT, ITS CONTRACTORS AND SUBCONTRACTORS, AS WELL AS ANY PRIOR RECIPIENT, TO THE EXTENT PERMITTED BY LAW.  RECIPIENT'S SOLE REMEDY FOR ANY SUCH
+// MATTER SHALL BE THE IMMEDIATE, UNILATERAL TERMINATION OF THIS AGREEMENT.
+
+#include <kodiak.hpp>
+
+using namespace kodiak;
+using std::cout;
+using std::endl;
+
+// Sum of the volumes of the boxes
+real volume(const Boxes &boxes) {
+    real sum = 0;
+    for (nat k = 0; k < boxes.size(); ++k) {
+        real v = 1;
+        for (nat i = 0; i < boxes[k].size(); ++i)
+            v *= boxes[k][i].diam();
+        sum += v;
+    }
+    return sum;
+}
+
+// Checks that two pavings cover the same volume with boxes of each type
+bool same(const Paving &p1, const Paving &p2) {
+    if (p1.ntypes() != p2.ntypes() || p1.roots().size() != p2.roots().size())
+        return false;
+    for (nat i = 0; i < p1.ntypes(); ++i) {
+        real v1 = volume(p1.boxes(i));
+        real v2 = volume(p2.boxes(i));
+        if (std::abs(v1 - v2) > 1e-9 * std::max(v1, v2))
+            return false;
+    }
+    return true;
+}
+
+// Wheel of the paving example, the caller sets the search options and paves it
+void wheel(Paver &p) {
+    Real x = var("x");
+    Real y = var("y");
+
+    p.var("x", -5, 5);
+    p.var("y", -5, 5);
+    p.le0((x ^ 2) + (y ^ 2) - 16);
+    p.ge0((x ^ 2) + (y ^ 2) - 4);
+    p.ge0(x * y);
+    p.set_resolutions(0.01);
+    p.set_precision(-2);
+}
+
+void binary(const bool test = false) {
+    if (!test) return;
+
+    Paver p("wheel");
+    wheel(p);
+    p.pave();
+    const Paving &paving = p.answer();
+    paving.save_binary("wheel.kpav");
+    PavingFile file("wheel.kpav");
+    for (nat i = 0; i < file.ntypes(); ++i)
+        cout << "Type " << i << ": " << file.size(i) << " boxes" << endl;
+    cout << "Round trip: " << (same(paving, file.paving()) ? "ok" : "failed") << endl;
+
+    // Types without boxes are kept
+    Paving sparse;
+    sparse.set_varbox(paving.varbox());
+    sparse.set_ntypes(4);
+    sparse.push_box(0, paving.boxes(0)[0]);
+    sparse.save_binary("sparse.kpav");
+    cout << "Types: " << PavingFile("sparse.kpav").paving().ntypes() << ", compressed: "
+            << CompressedPaving(sparse).paving().ntypes() << endl;
+
+    // Points are located in the paving without scanning its boxes
+    PavingIndex index(paving);
+    Point inside = {3, 0.5};
+    Point outside = {0, 0};
+    cout << "Type at (3, 0.5): " << index.type(inside) << ", at (0, 0): " << index.type(outside) << endl;
+    cout << endl;
+}
+
+void compressed(const bool test = false) {
+    if (!test) return;
+
+    Paver p("wheel");
+    wheel(p);
+    p.full();
+    const Paving &paving = p.answer();
+    CompressedPaving compressed(paving);
+    compressed.save("wheel.kcp");
+    CompressedPaving loaded;
+    loaded.load("wheel.kcp");
+    for (nat i = 0; i < paving.ntypes(); ++i)
+        cout << "Type " << i << ": " << paving.size(i) << " boxes, " << loaded.size(i) << " leaves" << endl;
+    cout << "Nodes: " << loaded.nodes() << ", Bytes: " << loaded.bytes() << endl;
+    cout << "Round trip: " << (same(paving, loaded.paving()) ? "ok" : "failed") << endl;
+
+    // Overlapping boxes are kept as they are
+    Paving overlapping;
+    overlapping.set_varbox(paving.varbox());
+    overlapping.push_box(0, paving.boxes(0)[0]);
+    overlapping.push_box(1, paving.boxes(0)[0]);
+    CompressedPaving kept(overlapping);
+    cout << "Overlapping boxes kept as they are: " << kept.others(0).size() + kept.others(1).size() << endl;
+
+    // Truncated files are rejected
+    std::ifstream in("wheel.kcp", std::ifstream::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream out("truncated.kcp", std::ofstream::binary);
+    out.write(bytes.data(), bytes.size() / 2);
+    out.close();
+    try {
+        loaded.load("truncated.kcp");
+    } catch (Growl const & growl) {
+        cout << growl.what() << endl;
+    }
+    cout << endl;
+}
+
+// Parallel, frontier, streaming and bounded searches compute the same paving, up to the
+// boxes coalesced to meet the budget
+void search(const bool test = false) {
+    if (!test) return;
+
+    Paver p("wheel");
+    wheel(p);
+    p.full();
+
+    Paver parallel("parallel");
+    wheel(parallel);
+    parallel.set_threads(4);
+    parallel.full();
+    cout << "Parallel: " << (same(p.answer(), parallel.answer()) ? "ok" : "failed") << endl;
+
+    Paver frontier("frontier");
+    wheel(frontier);
+    frontier.set_frontier(BEST_FIRST);
+    frontier.full();
+    cout << "Best first: " << (same(p.answer(), frontier.answer()) ? "ok" : "failed") << endl;
+
+    Paving streamed;
+    CallbackSink sink([&streamed](const nat type, const Box &box) {
+        if (type != PavingSink::ROOT)
+            streamed.push_box(type, box);
+    });
+    Paver streaming("streaming");
+    wheel(streaming);
+    streaming.set_sink(&sink);
+    streaming.full();
+    cout << "Streaming: " << (same(p.answer(), streamed) ? "ok" : "failed") << endl;
+
+    // The budget is a target: boxes that cannot be coalesced anymore are kept
+    Paver bounded("bounded");
+    wheel(bounded);
+    bounded.set_budget(20000);
+    bounded.full();
+    nat boxes = 0;
+    for (nat i = 0; i < bounded.answer().ntypes(); ++i)
+        boxes += bounded.answer().size(i);
+    cout << "Budget: " << boxes << " boxes, Peak: " << bounded.peak() << " bytes, Coalesced: "
+            << bounded.coalesced() << ", Summarized: " << bounded.summarized() << endl;
+    cout << endl;
+}
+
+int main(int, char *[]) {
+
+    Kodiak::init();
+    Kodiak::set_safe_input(false);
+
+    try {
+        binary(true);
+        compressed(true);
+        search(true);
+    } catch (Growl const & growl) {
+        cout << growl.what() << endl;
+    }
+}
@@ -109,11 +109,12 @@ void Bifurcation::bifurcation(const bool first, const bool equilibrium) {
 
 void Bifurcation::evaluate(PrePaving &paving, Ints &certainties, Environment &env) {
     currentBoxCertainty_ = 1;
-    Box aBox = env.box;
+    // Formulas are evaluated on the box of the node, which they leave as they find it
+    Box &aBox = env.box;
     for (nat f = 0; f < numberOfRelationalFormulas(); ++f) {
         // if f-th formula is certainly true, don't check it again
         if (certainties[f] > 0) continue;
-        if (!dirvars().empty() && relationalFormulas_[f].ope().isFresh(dirvars().back().var) &&
+        if (!dirvars().empty() && !formulaHasVar(f, dirvars().back().var) &&
                 where(dirvars(), dirvars().back().var) != EXTERIOR) {
             // top variable doesn't appear in f-th formula, don't check it again
             currentBoxCertainty_ = (currentBoxCertainty_ > 0 ? certainties[f] : std::max(currentBoxCertainty_, certainties[f]));
@@ -175,6 +176,12 @@ void Bifurcation::evaluate(PrePaving &paving, Ints &certainties, Environment &en
     paving.push_box(possibly_steady ? 0 : 1, aBox); // Whole interval (possibly)
 }
 
+BranchAndBoundDF<Ints, PrePaving, Environment> *Bifurcation::clone() const {
+    if (typeid(*this) != typeid(Bifurcation))
+        return NULL;
+    return new Bifurcation(*this);
+}
+
 void Bifurcation::print(std::ostream &os) const {
     os << "System: " << ID << std::endl;
     os << "Vars: ";
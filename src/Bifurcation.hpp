@@ -55,6 +55,7 @@ namespace kodiak {
 
     protected:
         void evaluate(PrePaving &, Ints &, Environment &);
+        BranchAndBoundDF<Ints, PrePaving, Environment> *clone() const;
 
     private:
         nat nvars_; // Number of variables
@@ -37,6 +37,12 @@ void BooleanChecker::select(DirVar &dirvar,
   round_robin(dirvar, e, box);
 }
 
+BranchAndBoundDF<Bool, Certainty, Environment> *BooleanChecker::clone() const {
+  if (typeid(*this) != typeid(BooleanChecker))
+    return nullptr;
+  return new BooleanChecker(*this);
+}
+
 Certainty BooleanChecker::check() {
   Environment env{EmptyBBox, variablesEnclosures_.box(), EmptyNamedBox};
   Certainty answer;
@@ -15,6 +15,11 @@ public:
 
   BooleanChecker() : _booleanExpression(True) {}
 
+  BooleanChecker(const BooleanChecker &other) :
+          System(other),
+          BranchAndBoundDF<Bool, Certainty, Environment>(other),
+          _booleanExpression(other._booleanExpression) {}
+
   void setExpression(const Bool &expr);
 
   void printDebuggingInfo(std::ostream &os = std::cout) const;
@@ -37,6 +42,14 @@ protected:
 
   virtual void select(DirVar &dirvar, Bool &e, Environment &box) override;
 
+  BranchAndBoundDF<Bool, Certainty, Environment> *clone() const override;
+
+
+  // Boolean expressions are not modified by the search, so they are never saved
+  void saveExpression(Bool &, const Bool &) override {}
+
+  void restoreExpression(Bool &, const Bool &) override {}
+
 private:
   Bool _booleanExpression;
   std::unique_ptr<Environment> witness_;
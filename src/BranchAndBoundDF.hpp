@@ -1,7 +1,14 @@
 #ifndef KODIAK_BRANCH_AND_BOUND
 #define KODIAK_BRANCH_AND_BOUND
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+
 #include "types.hpp"
+#include "WorkStealingPool.hpp"
 
 #ifdef DEBUG
 #include <boost/graph/graph_traits.hpp>
@@ -10,6 +17,11 @@
 
 namespace kodiak {
 
+    // Order in which the nodes of the search tree are explored (see set_frontier)
+    enum FrontierPolicy {
+        DEPTH_FIRST, BREADTH_FIRST, BEST_FIRST, HYBRID
+    };
+
     template <typename Expression, typename Answer, typename Environment> class BranchAndBoundDF {
     public:
 
@@ -19,6 +31,9 @@ namespace kodiak {
         using Vertex_t = typename boost::graph_traits<Graph>::vertex_descriptor;
 #endif
 
+        virtual ~BranchAndBoundDF() {
+        }
+
         nat splits() const {
             return splitCounter_;
         }
@@ -35,6 +50,8 @@ namespace kodiak {
             return debug_;
         }
 
+        // Time of the last search in milliseconds: CPU time of a sequential search, as clock(),
+        // and wall time of a parallel one, since the CPU time of all the threads adds up
         clock_t time() const {
             return timeInMls_;
         }
@@ -52,6 +69,45 @@ namespace kodiak {
             debug_ = debug;
         }
 
+        nat threads() const {
+            return threads_;
+        }
+
+        // Number of threads used by the branch and bound algorithm. Parallel search
+        // requires an engine that implements clone, otherwise the search is sequential.
+        void set_threads(const nat threads) {
+            threads_ = threads;
+        }
+
+        nat spawndepth() const {
+            return spawnDepth_;
+        }
+
+        // In parallel search, the second branch of a node whose depth is at most
+        // spawndepth is explored as a task of the pool. 0 means that the depth is
+        // chosen from the number of threads.
+        void set_spawndepth(const nat depth) {
+            spawnDepth_ = depth;
+        }
+
+        FrontierPolicy frontier() const {
+            return frontier_;
+        }
+
+        nat maxopen() const {
+            return maxOpen_;
+        }
+
+        // Order in which the search tree is explored. BEST_FIRST explores first the nodes of
+        // highest priority and HYBRID dives depth-first from each of them. Policies other than
+        // DEPTH_FIRST keep the open nodes in memory: when there are maxopen of them, the next
+        // node is explored depth-first (0 means no limit). Parallel search only applies to
+        // the subtrees explored depth-first.
+        void set_frontier(const FrontierPolicy frontier, const nat maxopen = 100000) {
+            frontier_ = frontier;
+            maxOpen_ = maxopen;
+        }
+
         const Expression &theExpr() const {
             return initialExpression_;
         }
@@ -62,7 +118,8 @@ namespace kodiak {
 
     protected:
 
-        BranchAndBoundDF() : maximumDepth_(0), currentDepth_(0), splitCounter_(0), timeInMls_(0), debug_(0) {
+        BranchAndBoundDF() : maximumDepth_(0), currentDepth_(0), splitCounter_(0), timeInMls_(0), debug_(0),
+        globalExit_(false), threads_(1), spawnDepth_(0), pool_(NULL), frontier_(DEPTH_FIRST), maxOpen_(100000) {
 #ifdef DEBUG
             this->root = boost::add_vertex(this->graph);
             this->current = this->root;
@@ -83,6 +140,15 @@ namespace kodiak {
         virtual void unbranch(Expression &, Environment &) {
         }
 
+        // Depth-first search. Called right before the children of a node are explored and once
+        // they are done, but not when frontier search only queues them. Engines may keep state
+        // along the path of the search, e.g., the enclosures of the node being split.
+        virtual void descend() {
+        }
+
+        virtual void ascend() {
+        }
+
         virtual void accumulate(const Answer &) {
         }
 
@@ -102,6 +168,19 @@ namespace kodiak {
             return true;
         }
 
+        // Contraction stage, between the evaluation and the selection of a node. It may narrow
+        // the box to a sub-box that contains all the solutions of the node, and returns false
+        // if the node is a leaf, e.g., there are no solutions. The answer of the node is
+        // updated accordingly. The box received by the node is restored once the node is done.
+        // contract is only called when contracting is true.
+        virtual bool contracting() const {
+            return false;
+        }
+
+        virtual bool contract(Answer &, Expression &, Environment &) {
+            return true;
+        }
+
         virtual void select(DirVar &dirvar, Expression &e, Environment &box) {
             round_robin(dirvar, e, box);
         }
@@ -126,6 +205,50 @@ namespace kodiak {
             }
         }
 
+        // Parallel search. Returns a new engine, in the same state as this one, that
+        // doesn't share mutable data (e.g., evaluation tapes) with it. Real expressions
+        // can be shared, since they are not modified by evaluation.
+        // NULL disables parallel search, e.g., subclasses that don't override clone are
+        // explored sequentially.
+        virtual BranchAndBoundDF *clone() const {
+            return NULL;
+        }
+
+        // Parallel search. Merges the accumulated state of a clone of this engine once
+        // it has explored the second branch of the current node.
+        virtual void merge(const BranchAndBoundDF &) {
+        }
+
+        // Undo log of the expression. The expression received by a node is saved before the
+        // node is evaluated and restored once the node is done, so that evaluate, select and
+        // branch may modify it. Engines that never modify the expression may skip the copy.
+        virtual void saveExpression(Expression &saved, const Expression &e) {
+            saved = e;
+        }
+
+        virtual void restoreExpression(Expression &e, const Expression &saved) {
+            e = saved;
+        }
+
+        // Frontier search. Priority of the children of a node, computed from the answer and
+        // the expression of the node once it has been evaluated.
+        virtual real priority(const Answer &, const Expression &, const Environment &) {
+            return 0;
+        }
+
+        // Frontier search. Called when the search moves to a node that doesn't follow the
+        // previous one in depth-first order, once dirvars() has been restored. Engines that keep
+        // state along the path of the search (e.g., pushed in split and popped in combine)
+        // rebuild it as it is right after the last split of dirvars().
+        virtual void resume() {
+        }
+
+        // Best-first search. True if the search may stop when the best open node has the given
+        // priority. The open nodes left then take the answer of their parent.
+        virtual bool stop(const real) {
+            return false;
+        }
+
         virtual void split(const DirVar &dirvar, Environment &box, const Interval &i, const real mid) {
             if (dirvar.dir)
                 box[dirvar.var] = Interval(i.inf(), mid);
@@ -145,11 +268,27 @@ namespace kodiak {
             currentDepth_ = 0;
             globalExit_ = false;
 
-            clock_ = clock();
+            clock_t cpuClock = clock();
+            std::chrono::steady_clock::time_point wallClock = std::chrono::steady_clock::now();
             Expression nexpr = expr;
             Environment nbox = box;
-            internalBranchAndBound(answer, nexpr, nbox);
-            timeInMls_ = 1000 * (clock() - clock_) / CLOCKS_PER_SEC;
+            if (threads_ > 1) {
+                WorkStealingPool pool(threads_);
+                pool_ = &pool;
+                try {
+                    search(answer, nexpr, nbox);
+                } catch (...) {
+                    pool_ = NULL;
+                    throw;
+                }
+                pool_ = NULL;
+            } else
+                search(answer, nexpr, nbox);
+            if (threads_ > 1)
+                timeInMls_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - wallClock).count();
+            else
+                timeInMls_ = 1000 * (clock() - cpuClock) / CLOCKS_PER_SEC;
             assert(debug_ == 0 || isSound(answer, initialExpression_, initialBox_));
         }
 
@@ -163,66 +302,525 @@ namespace kodiak {
 
     private:
 
-        void internalBranchAndBound(Answer &answer, const Expression &expr, Environment &box) {
+        // Second branch of a node explored by a different engine
+        struct Worker {
+            Worker(WorkStealingPool &pool) : pool(pool), cancelled(false) {
+            }
 
-#ifdef DEBUG
-            auto previousNode = this->current;
-            auto thisNode = boost::add_vertex(this->graph);
-            this->current = thisNode;
-            boost::add_edge(previousNode, this->current, this->graph);
-            this->graph[this->current].env = box;
-#endif
+            ~Worker() {
+                if (task) {
+                    cancelled = true;
+                    try {
+                        pool.wait(task);
+                    } catch (...) {
+                    }
+                }
+            }
 
-            nat depth = selectionsStack_.size();
-            if (depth > currentDepth_)
-                currentDepth_ = depth;
-            Expression e = expr;
-            evaluate(answer, e, box);
-            accumulate(answer);
+            WorkStealingPool &pool;
+            std::unique_ptr<BranchAndBoundDF> engine;
+            Expression expr;
+            Environment box;
+            Answer answer;
+            std::atomic<bool> cancelled;
+            WorkStealingPool::TaskPtr task;
+        };
+
+        nat maxSpawnDepth() const {
+            if (spawnDepth_ > 0)
+                return spawnDepth_;
+            nat depth = 0;
+            while ((1u << depth) < 16 * threads_)
+                ++depth;
+            return depth;
+        }
 
-#ifdef DEBUG
-            this->graph[thisNode].ans = answer;
+        bool cancelled() const {
+            for (nat k = 0; k < cancelled_.size(); ++k)
+                if (*cancelled_[k]) return true;
+            return false;
+        }
+
+        // Called right after the first split of a node. It spawns a task that explores the
+        // second branch on a clone of this engine. Returns NULL if the second branch must
+        // be explored sequentially.
+        std::unique_ptr<Worker> spawn(DirVar dirvar, const Expression &e, const Environment &box,
+                const Interval &i, const real mid) {
+#ifndef DEBUG // The search graph of debug builds isn't thread-safe, so they stay sequential
+            if (pool_ == NULL || dirvar.onlyone || selectionsStack_.size() > maxSpawnDepth())
+                return NULL;
+            BranchAndBoundDF *engine = clone();
+            if (engine == NULL)
+                return NULL;
+            std::unique_ptr<Worker> worker(new Worker(*pool_));
+            worker->engine.reset(engine);
+            worker->expr = e;
+            worker->box = box;
+            engine->splitCounter_ = 0;
+            engine->currentDepth_ = 0;
+            engine->cancelled_.push_back(&worker->cancelled);
+            dirvar.next();
+            engine->selectionsStack_.pop_back();
+            engine->split(dirvar, worker->box, i, mid);
+            engine->selectionsStack_.push_back(dirvar);
+            engine->branch(worker->expr, worker->box);
+            engine->descend();
+            Worker *w = worker.get();
+            worker->task = pool_->spawn([w] {
+                w->engine->internalBranchAndBound(w->answer, w->expr, w->box);
+            });
+            return worker;
+#else
+            return NULL;
 #endif
+        }
 
-            ++splitCounter_;
-            globalExit_ = global_exit(answer);
-            if (box.empty() || (maximumDepth_ > 0 && depth + 1 >= maximumDepth_) ||
-                    globalExit_ || local_exit(answer) || prune(answer))
-                return;
-            DirVar dirvar;
-            select(dirvar, e, box);
-            if (dirvar.var >= box.size())
-                return;
-            Interval i = box[dirvar.var];
-            real mid = i.mid();
-            split(dirvar, box, i, mid);
-            selectionsStack_.push_back(dirvar);
+        // Waits for the second branch and merges the state of its engine
+        void join(Answer &answer, Worker &worker) {
+            WorkStealingPool::TaskPtr task = worker.task;
+            worker.task.reset();
+            pool_->wait(task);
+            answer = worker.answer;
+            splitCounter_ += worker.engine->splitCounter_;
+            if (worker.engine->currentDepth_ > currentDepth_)
+                currentDepth_ = worker.engine->currentDepth_;
+            globalExit_ = worker.engine->globalExit_;
+            merge(*worker.engine);
+        }
+
+        enum Stage {
+            VISIT, FIRST_BRANCH, SECOND_BRANCH
+        };
+
+        // State of a node of the search tree in the explicit stack of internalBranchAndBound
+        struct Frame {
+            Stage stage;
+            Answer *answer; // Points to ans1 or ans2 of the parent node
             Answer ans1;
-            branch(e, box);
-            internalBranchAndBound(ans1, e, box);
-            unbranch(e, box);
-            if (globalExit_) dirvar.onlyone = true;
-            if (dirvar.onlyone) {
+            Answer ans2;
+            Expression saved; // Undo log: expression as received from the parent node
+            Environment original; // Box as received from the parent node, when contracted
+            bool contracted;
+            DirVar dirvar;
+            Interval i;
+            real mid;
+            std::unique_ptr<Worker> worker;
+#ifdef DEBUG
+            Vertex_t previousNode;
+            Vertex_t thisNode;
+#endif
+        };
+
+        // Depth-first search with an explicit stack. The box and the expression are shared
+        // by all the nodes: the box is restored after each split (or when the node is done,
+        // if it has been contracted) and the expression is restored from the undo log when
+        // a node is done. Frames are reused, so after the first descent no memory is
+        // allocated per node.
+        void internalBranchAndBound(Answer &answer, Expression &e, Environment &box) {
+            std::deque<Frame> frames;
+            nat top = 0;
+            auto push = [&frames, &top](Answer &ans) {
+                if (top == frames.size())
+                    frames.emplace_back();
+                Frame &f = frames[top++];
+                f.stage = VISIT;
+                f.answer = &ans;
+            };
+            push(answer);
+            while (top > 0) {
+                Frame &f = frames[top - 1];
+                if (f.stage == VISIT) {
+                    if (!cancelled_.empty() && cancelled()) {
+                        --top;
+                        continue;
+                    }
+#ifdef DEBUG
+                    f.previousNode = this->current;
+                    f.thisNode = boost::add_vertex(this->graph);
+                    this->current = f.thisNode;
+                    boost::add_edge(f.previousNode, this->current, this->graph);
+                    this->graph[this->current].env = box;
+#endif
+                    nat depth = selectionsStack_.size();
+                    if (depth > currentDepth_)
+                        currentDepth_ = depth;
+                    saveExpression(f.saved, e);
+                    evaluate(*f.answer, e, box);
+                    accumulate(*f.answer);
+#ifdef DEBUG
+                    this->graph[f.thisNode].ans = *f.answer;
+#endif
+                    ++splitCounter_;
+                    globalExit_ = global_exit(*f.answer);
+                    if (box.empty() || (maximumDepth_ > 0 && depth + 1 >= maximumDepth_) ||
+                            globalExit_ || local_exit(*f.answer) || prune(*f.answer)) {
+                        restoreExpression(e, f.saved);
+                        --top;
+                        continue;
+                    }
+                    f.contracted = contracting();
+                    if (f.contracted) {
+                        f.original = box;
+                        if (!contract(*f.answer, e, box)) {
+                            box = f.original;
+                            restoreExpression(e, f.saved);
+                            --top;
+                            continue;
+                        }
+                    }
+                    f.dirvar = DirVar();
+                    select(f.dirvar, e, box);
+                    if (f.dirvar.var >= box.size()) {
+                        if (f.contracted)
+                            box = f.original;
+                        restoreExpression(e, f.saved);
+                        --top;
+                        continue;
+                    }
+                    f.i = box[f.dirvar.var];
+                    f.mid = f.i.mid();
+                    split(f.dirvar, box, f.i, f.mid);
+                    selectionsStack_.push_back(f.dirvar);
+                    f.worker = spawn(f.dirvar, e, box, f.i, f.mid);
+                    f.ans1 = Answer();
+                    branch(e, box);
+                    descend();
+                    f.stage = FIRST_BRANCH;
+                    push(f.ans1);
+                    continue;
+                }
+                if (f.stage == FIRST_BRANCH) {
+                    ascend();
+                    unbranch(e, box);
+                    if (globalExit_) f.dirvar.onlyone = true;
+                    if (f.dirvar.onlyone) {
+                        f.worker.reset();
+                        selectionsStack_.pop_back();
+                        box[f.dirvar.var] = f.i;
+                        combine(*f.answer, f.dirvar, f.ans1);
+                        if (f.contracted)
+                            box = f.original;
+                        restoreExpression(e, f.saved);
+                        --top;
+                        continue;
+                    }
+                    f.dirvar.next();
+                    selectionsStack_.pop_back();
+                    split(f.dirvar, box, f.i, f.mid);
+                    selectionsStack_.push_back(f.dirvar);
+                    f.ans2 = Answer();
+                    if (!f.worker) {
+                        branch(e, box);
+                        descend();
+#ifdef DEBUG
+                        this->current = f.thisNode;
+#endif
+                        f.stage = SECOND_BRANCH;
+                        push(f.ans2);
+                        continue;
+                    }
+                    join(f.ans2, *f.worker);
+                    f.worker.reset();
+                } else {
+                    ascend();
+                    unbranch(e, box);
+                }
                 selectionsStack_.pop_back();
-                box[dirvar.var] = i;
-                combine(answer, dirvar, ans1);
-                return;
+                box[f.dirvar.var] = f.i;
+                combine(*f.answer, f.dirvar, f.ans1, f.ans2);
+                if (f.contracted)
+                    box = f.original;
+#ifdef DEBUG
+                this->current = f.previousNode;
+#endif
+                restoreExpression(e, f.saved);
+                --top;
             }
-            dirvar.next();
-            selectionsStack_.pop_back();
-            split(dirvar, box, i, mid);
-            selectionsStack_.push_back(dirvar);
+        }
+
+        void search(Answer &answer, Expression &e, Environment &box) {
+            if (frontier_ == DEPTH_FIRST)
+                internalBranchAndBound(answer, e, box);
+            else
+                frontierBranchAndBound(answer, e, box);
+        }
+
+        static const nat NONE = static_cast<nat>(-1);
+
+        // Frontier search. Node of the search tree waiting for the answers of its children
+        struct Record {
+            nat parent; // NONE if the node is the root
+            bool second; // The node is the second child of its parent
+            DirVars path; // Selections of the node
+            DirVar dirvar; // Selection of the first child
+            Answer ans1;
             Answer ans2;
-            branch(e, box);
+            bool done1;
+            bool done2;
+        };
+
+        // Frontier search. Node of the search tree not explored yet
+        struct Open {
+            nat record; // Parent of the node, NONE if the node is the root
+            bool second; // The node is the second child of its parent
+            Expression expr;
+            Environment box;
+            DirVars path; // Selections of the node
 #ifdef DEBUG
-            this->current = thisNode;
+            Vertex_t parentVertex;
 #endif
-            internalBranchAndBound(ans2, e, box);
-            unbranch(e, box);
+        };
+
+        struct Entry {
+            real priority;
+            nat seq; // Order of creation, breaks ties
+            nat open;
+        };
+
+        struct Search {
+            Answer *answer; // Answer of the root
+            std::deque<Record> records;
+            std::vector<nat> freeRecords;
+            std::deque<Open> opens;
+            std::vector<nat> freeOpens;
+            std::vector<Entry> heap;
+            nat seq;
+        };
+
+        static nat allocate(std::vector<nat> &free, nat size) {
+            if (free.empty())
+                return size;
+            nat k = free.back();
+            free.pop_back();
+            return k;
+        }
+
+        Answer &slot(Search &s, const nat record, const bool second) {
+            if (record == NONE)
+                return *s.answer;
+            return second ? s.records[record].ans2 : s.records[record].ans1;
+        }
+
+        // True if b is explored before a. Ties are explored depth-first.
+        bool lower(const Entry &a, const Entry &b) const {
+            if (frontier_ == BREADTH_FIRST)
+                return a.seq > b.seq;
+            return a.priority < b.priority || (a.priority == b.priority && a.seq < b.seq);
+        }
+
+        void push(Search &s, const nat open, const real priority) {
+            Entry entry = {priority, s.seq++, open};
+            s.heap.push_back(entry);
+            std::push_heap(s.heap.begin(), s.heap.end(), [this](const Entry &a, const Entry &b) {
+                return lower(a, b);
+            });
+        }
+
+        nat pop(Search &s) {
+            std::pop_heap(s.heap.begin(), s.heap.end(), [this](const Entry &a, const Entry &b) {
+                return lower(a, b);
+            });
+            nat open = s.heap.back().open;
+            s.heap.pop_back();
+            return open;
+        }
+
+        // Creates the open node of a child of node, which has been evaluated and whose
+        // selections are in selectionsStack_
+        nat openChild(Search &s, Open &node, const nat record, const bool second,
+                const DirVar &dirvar, const Interval &i, const real mid) {
+            nat n = allocate(s.freeOpens, s.opens.size());
+            if (n == s.opens.size())
+                s.opens.emplace_back();
+            Open &child = s.opens[n];
+            split(dirvar, node.box, i, mid);
+            selectionsStack_.push_back(dirvar);
+            branch(node.expr, node.box);
+            child.record = record;
+            child.second = second;
+            child.expr = node.expr;
+            child.box = node.box;
+            child.path = selectionsStack_;
+#ifdef DEBUG
+            child.parentVertex = this->current;
+#endif
+            unbranch(node.expr, node.box);
             selectionsStack_.pop_back();
-            box[dirvar.var] = i;
-            combine(answer, dirvar, ans1, ans2);
+            node.box[dirvar.var] = i;
+            return n;
+        }
 
+        // Restores the state of the search as it is right before combining the answers of record
+        void resumeRecord(const Record &record, const DirVar &dirvar) {
+            selectionsStack_ = record.path;
+            selectionsStack_.push_back(dirvar);
+            resume();
+            selectionsStack_.pop_back();
+        }
+
+        // The answer of a child of record is done. Combines the answers of the nodes whose
+        // children are all done.
+        void complete(Search &s, nat record, bool second) {
+            while (record != NONE) {
+                Record &rec = s.records[record];
+                (second ? rec.done2 : rec.done1) = true;
+                if (!rec.done1 || (!rec.done2 && !rec.dirvar.onlyone))
+                    return;
+                DirVar dirvar = rec.dirvar;
+                if (!dirvar.onlyone)
+                    dirvar.next();
+                resumeRecord(rec, dirvar);
+                Answer &answer = slot(s, rec.parent, rec.second);
+                if (rec.dirvar.onlyone)
+                    combine(answer, dirvar, rec.ans1);
+                else
+                    combine(answer, dirvar, rec.ans1, rec.ans2);
+                second = rec.second;
+                s.freeRecords.push_back(record);
+                record = rec.parent;
+            }
+        }
+
+        // A child of record satisfies global exit. As in the depth-first search, the answers
+        // of the nodes not done yet are discarded.
+        void exitPath(Search &s, nat record, bool second) {
+            while (record != NONE) {
+                Record &rec = s.records[record];
+                DirVar dirvar = rec.dirvar;
+                if (second)
+                    dirvar.next();
+                resumeRecord(rec, dirvar);
+                Answer &answer = slot(s, rec.parent, rec.second);
+                if (second && rec.done1)
+                    combine(answer, dirvar, rec.ans1, rec.ans2);
+                else {
+                    dirvar.onlyone = true;
+                    combine(answer, dirvar, second ? rec.ans2 : rec.ans1);
+                }
+                second = rec.second;
+                record = rec.parent;
+            }
+        }
+
+        // The search stops before the open nodes are explored. Each one takes the answer of its
+        // parent, which is not combined until all its children are done.
+        void close(Search &s) {
+            for (nat k = 0; k < s.heap.size(); ++k) {
+                const Open &node = s.opens[s.heap[k].open];
+                const Record &rec = s.records[node.record];
+                slot(s, node.record, node.second) = slot(s, rec.parent, rec.second);
+                complete(s, node.record, node.second);
+            }
+            s.heap.clear();
+        }
+
+        // Search whose open nodes are ordered by frontier_. Each open node keeps its own
+        // expression, box and selections, and each node waiting for its children keeps their
+        // answers, so that they are combined in the same way as in the depth-first search.
+        void frontierBranchAndBound(Answer &answer, Expression &expr, Environment &box) {
+            Search s;
+            s.answer = &answer;
+            s.seq = 0;
+            s.opens.emplace_back();
+            Open &root = s.opens[0];
+            root.record = NONE;
+            root.second = false;
+            root.expr = expr;
+            root.box = box;
+            root.path = selectionsStack_;
+            DirVars path = selectionsStack_;
+#ifdef DEBUG
+            root.parentVertex = this->current;
+            auto previousNode = this->current;
+#endif
+            nat next = 0; // Node explored next without going through the heap (HYBRID)
+            nat previous = NONE;
+            while (next != NONE || !s.heap.empty()) {
+                if (previous != NONE)
+                    s.freeOpens.push_back(previous);
+                if (next == NONE && frontier_ != BREADTH_FIRST && stop(s.heap.front().priority)) {
+                    close(s);
+                    break;
+                }
+                nat current = next == NONE ? pop(s) : next;
+                next = NONE;
+                previous = current;
+                Open &node = s.opens[current];
+                selectionsStack_.swap(node.path);
+                resume();
+                nat record = node.record;
+                bool second = node.second;
+                Answer &ans = slot(s, record, second);
+                if (maxOpen_ > 0 && s.heap.size() >= maxOpen_) {
+#ifdef DEBUG
+                    this->current = node.parentVertex;
+#endif
+                    internalBranchAndBound(ans, node.expr, node.box);
+                    if (globalExit_) {
+                        exitPath(s, record, second);
+                        break;
+                    }
+                    complete(s, record, second);
+                    continue;
+                }
+#ifdef DEBUG
+                auto thisNode = boost::add_vertex(this->graph);
+                boost::add_edge(node.parentVertex, thisNode, this->graph);
+                this->graph[thisNode].env = node.box;
+                this->current = thisNode;
+#endif
+                nat depth = selectionsStack_.size();
+                if (depth > currentDepth_)
+                    currentDepth_ = depth;
+                evaluate(ans, node.expr, node.box);
+                accumulate(ans);
+#ifdef DEBUG
+                this->graph[thisNode].ans = ans;
+#endif
+                ++splitCounter_;
+                globalExit_ = global_exit(ans);
+                if (globalExit_) {
+                    exitPath(s, record, second);
+                    break;
+                }
+                if (node.box.empty() || (maximumDepth_ > 0 && depth + 1 >= maximumDepth_) ||
+                        local_exit(ans) || prune(ans) || (contracting() && !contract(ans, node.expr, node.box))) {
+                    complete(s, record, second);
+                    continue;
+                }
+                DirVar dirvar;
+                select(dirvar, node.expr, node.box);
+                if (dirvar.var >= node.box.size()) {
+                    complete(s, record, second);
+                    continue;
+                }
+                real p = priority(ans, node.expr, node.box);
+                nat r = allocate(s.freeRecords, s.records.size());
+                if (r == s.records.size())
+                    s.records.emplace_back();
+                Record &rec = s.records[r];
+                rec.parent = record;
+                rec.second = second;
+                rec.path = selectionsStack_;
+                rec.dirvar = dirvar;
+                rec.ans1 = Answer();
+                rec.ans2 = Answer();
+                rec.done1 = false;
+                rec.done2 = false;
+                Interval i = node.box[dirvar.var];
+                real mid = i.mid();
+                nat child1 = openChild(s, node, r, false, dirvar, i, mid);
+                if (!dirvar.onlyone) {
+                    dirvar.next();
+                    push(s, openChild(s, node, r, true, dirvar, i, mid), p);
+                }
+                if (frontier_ == HYBRID)
+                    next = child1;
+                else
+                    push(s, child1, p);
+            }
+            selectionsStack_ = path;
+            resume();
 #ifdef DEBUG
             this->current = previousNode;
 #endif
@@ -237,12 +835,17 @@ namespace kodiak {
         nat        currentDepth_;
         nat        splitCounter_;
         DirVars    selectionsStack_;
-        clock_t    clock_;
         clock_t    timeInMls_;
         Expression initialExpression_;
         Environment        initialBox_;
         nat        debug_; // If debug >= 0, assert sound predicate
         bool       globalExit_;
+        nat        threads_; // Number of threads for parallel search
+        nat        spawnDepth_;
+        WorkStealingPool *pool_; // Pool of the current parallel search, shared by clones
+        std::vector<const std::atomic<bool> *> cancelled_; // Cancellation flags of the tasks this engine runs in
+        FrontierPolicy frontier_;
+        nat        maxOpen_; // Maximum number of open nodes of the frontier search
 
 #ifdef DEBUG
     public:
@@ -0,0 +1,962 @@
+#include "CompiledExpr.hpp"
+#include "Node.hpp"
+
+using namespace kodiak;
+
+void CompiledExpr::compile(const Real &e, const bool expand) {
+    expr_ = e;
+    code_.clear();
+    regs_.clear();
+    names_.clear();
+    slots_.clear();
+    layout_ = 0;
+    exprs_.clear();
+    calls_.clear();
+    messages_.clear();
+    result_ = 0;
+    nvars_ = 0;
+    grads_.clear();
+    namePartials_.clear();
+    callPartials_.clear();
+    straight_ = true;
+    cached_ = false;
+    box_.clear();
+    saved_.clear();
+    synced_ = 0;
+    if (e.notAReal())
+        return;
+    Compiler c;
+    c.scopeId = 0;
+    c.scopes = 0;
+    c.expand = expand;
+    result_ = compile(e, c, true);
+}
+
+// Compiles e and returns the register of its value. The Boolean parameter is the enclosure flag
+// that Real::eval would receive when evaluating e, assuming the enclosure flag of eval is true.
+
+nat CompiledExpr::compile(const Real &e, Compiler &c, const bool enclosure) {
+    if (e.notAReal())
+        return fail("Kodiak (eval): evaluation of NotAReal is undefined");
+    bool enc = enclosure && !e.vars().linear();
+    Key key(std::make_pair(e.node_, e.closed() ? 0 : c.scopeId), enc);
+    Memo::const_iterator it = c.memo.find(key);
+    if (it != c.memo.end())
+        return it->second;
+    nat r = c.expand && e.isPolynomial() ? compileMonomials(e, c, enc) :
+            e.isPolynomial() || e.isRational() ? compileCall(e, c, enc) : compileNode(e, c, enc);
+    c.memo[key] = r;
+    return r;
+}
+
+nat CompiledExpr::compileCall(const Real &e, Compiler &c, const bool enclosure) {
+    Call call;
+    call.expr = exprs_.size();
+    call.enclosure = enclosure;
+    call.scope = c.scope;
+    call.named = !c.scope.empty() || e.open() || !e.consts().empty();
+    exprs_.push_back(e);
+    calls_.push_back(call);
+    return emit(CALL, 0, 0, calls_.size() - 1);
+}
+
+// Monomials are kept in exprs_, since registers are memoized by node
+
+nat CompiledExpr::compileMonomials(const Real &e, Compiler &c, const bool enclosure) {
+    const Monomials &monoms = e.monoms();
+    if (monoms.empty())
+        return reg(Interval(0));
+    nat r = 0;
+    for (nat k = 0; k < monoms.size(); ++k) {
+        Real m = monoms[k].realExpr(e.names());
+        exprs_.push_back(m);
+        nat term = compile(m, c, enclosure);
+        r = k == 0 ? term : emit(ADD, r, term);
+    }
+    return r;
+}
+
+nat CompiledExpr::compileNode(const Real &e, Compiler &c, const bool enc) {
+    if (e.isVal())
+        return reg(e.val());
+    if (e.isVar()) {
+        exprs_.push_back(e);
+        return emit(VAR, exprs_.size() - 1, 0, e.var());
+    }
+    if (e.isName()) {
+        std::string nm = e.name();
+        for (nat k = c.scope.size(); k > 0; --k) {
+            if (names_[c.scope[k - 1].first] == nm)
+                return c.scope[k - 1].second;
+        }
+        return emit(NAME, e.open() ? 1 : 0, 0, name(nm));
+    }
+    if (e.isUnary()) {
+        nat ope = compile(e.ope1(), c, enc);
+        switch (e.op()) {
+            case kodiak::NEG: return emit(NEG, ope);
+            case kodiak::ABS: return emit(ABS, ope);
+            case kodiak::SQ: return emit(SQ, ope);
+            case kodiak::SQRT: return emit(SQRT, ope);
+            case kodiak::EXP: return emit(EXP, ope);
+            case kodiak::LN: return emit(LN, ope);
+            case kodiak::SIN: return emit(SIN, ope);
+            case kodiak::COS: return emit(COS, ope);
+            case kodiak::TAN: return emit(TAN, ope);
+            case kodiak::ASIN: return emit(ASIN, ope);
+            case kodiak::ACOS: return emit(ACOS, ope);
+            case kodiak::ATAN: return emit(ATAN, ope);
+            case kodiak::SINGLE_ULP: return emit(SINGLE_ULP, ope);
+            case kodiak::DOUBLE_ULP: return emit(DOUBLE_ULP, ope);
+            case kodiak::DOUBLE_FEXP: return emit(DOUBLE_FEXP, ope);
+            default: return fail("Kodiak (eval): unary operator not supported");
+        }
+    }
+    if (e.isBinary()) {
+        switch (e.op()) {
+            case kodiak::ADD:
+            case kodiak::SUB:
+            case kodiak::MULT:
+            {
+                nat ope1 = compile(e.ope1(), c, enc);
+                nat ope2 = compile(e.ope2(), c, enc);
+                return emit(e.op() == kodiak::ADD ? ADD : e.op() == kodiak::SUB ? SUB : MULT, ope1, ope2);
+            }
+            case kodiak::DIV:
+            {
+                // Divisor is evaluated and checked before the dividend, as in RealBinary_Node::eval
+                nat ope2 = compile(e.ope2(), c, enc);
+                emit(DIVISOR, ope2);
+                nat ope1 = compile(e.ope1(), c, enc);
+                return emit(DIV, ope1, ope2);
+            }
+            default:
+                return fail("Kodiak (eval): binary operator not supported");
+        }
+    }
+    if (e.isPower())
+        return emit(POW, compile(e.ope1(), c, enc), 0, e.expn());
+    if (e.isLetin()) {
+        std::string nm = e.name();
+        nat let = compile(e.ope1(), c, enc);
+        for (nat k = 0; k < c.scope.size(); ++k) {
+            if (names_[c.scope[k].first] == nm) {
+                std::ostringstream os;
+                os << "Kodiak (push): name \"" << nm << "\" already exists in named box";
+                return fail(os.str());
+            }
+        }
+        nat l = name(nm);
+        emit(LET, 0, 0, l);
+        nat scopeId = c.scopeId;
+        c.scope.push_back(Binding(l, let));
+        c.scopeId = ++c.scopes;
+        nat in = compile(e.ope2(), c, enc);
+        c.scope.pop_back();
+        c.scopeId = scopeId;
+        return in;
+    }
+    if (e.isIfnz()) {
+        nat cond = compile(e.ope1(), c, enc);
+        straight_ = false;
+        nat dst = reg();
+        nat ifnz = code_.size();
+        Instruction i = {IFNZ, dst, cond, 0, 0};
+        code_.push_back(i);
+        // Nodes evaluated in one branch are not available in the other one, nor after the ifnz
+        Memo memo = c.memo;
+        Instruction lt = {MOVE, dst, compile(e.ope2(), c, enc), 0, 0};
+        code_.push_back(lt);
+        nat jump = code_.size();
+        Instruction j = {JUMP, 0, 0, 0, 0};
+        code_.push_back(j);
+        code_[ifnz].aux = code_.size();
+        c.memo = memo;
+        Instruction gt = {MOVE, dst, compile(e.ope3(), c, enc), 0, 0};
+        code_.push_back(gt);
+        code_[jump].aux = code_.size();
+        c.memo = memo;
+        return dst;
+    }
+    if (e.isError()) {
+        Error_Node *node = static_cast<Error_Node *> (e.node_);
+        nat value = compile(node->getValue(), c, enc);
+        nat error = compile(node->getError(), c, enc);
+        return emit(ERROR, value, error);
+    }
+    if (e.isFloor())
+        return emit(FLOOR, compile(static_cast<Floor_Node *> (e.node_)->getOperand(), c, enc));
+    if (e.isMax() || e.isMin()) {
+        const Realn &operands = e.isMax() ?
+                static_cast<Max_Node *> (e.node_)->getOperands() :
+                static_cast<Min_Node *> (e.node_)->getOperands();
+        // Max_Node::eval also compares the first operand with itself, which doesn't change the result
+        nat acc = compile(operands[0], c, enc);
+        for (nat k = 1; k < operands.size(); ++k)
+            acc = emit(e.isMax() ? MAX : MIN, acc, compile(operands[k], c, enc));
+        return acc;
+    }
+    return compileCall(e, c, enc);
+}
+
+// Appends an instruction that writes a new register and returns that register
+
+nat CompiledExpr::emit(const Code code, const nat ope1, const nat ope2, const nat aux) {
+    Instruction i = {code, reg(), ope1, ope2, aux};
+    code_.push_back(i);
+    return i.dst;
+}
+
+nat CompiledExpr::fail(const std::string &msg) {
+    messages_.push_back(msg);
+    return emit(FAIL, 0, 0, messages_.size() - 1);
+}
+
+nat CompiledExpr::name(const std::string &nm) {
+    for (nat k = 0; k < names_.size(); ++k) {
+        if (names_[k] == nm)
+            return k;
+    }
+    names_.push_back(nm);
+    return names_.size() - 1;
+}
+
+nat CompiledExpr::reg(const Interval &i) {
+    regs_.push_back(i);
+    return regs_.size() - 1;
+}
+
+Interval CompiledExpr::eval(const Box &box, NamedBox &constbox, const bool enclosure) {
+    if (!run(box, constbox, enclosure, false))
+        throw Growl(error_);
+    return regs_[result_];
+}
+
+Interval CompiledExpr::eval(const Box &box, NamedBox &constbox, Box &gradient, const bool enclosure) {
+    if (!run(box, constbox, enclosure, nvars_ > 0))
+        throw Growl(error_);
+    gradient.assign(grads_.begin() + result_ * nvars_, grads_.begin() + (result_ + 1) * nvars_);
+    return regs_[result_];
+}
+
+bool CompiledExpr::tryEval(Interval &X, const Box &box, NamedBox &constbox, const bool enclosure) {
+    if (!run(box, constbox, enclosure, false))
+        return false;
+    X = regs_[result_];
+    return true;
+}
+
+bool CompiledExpr::tryEval(Interval &X, const Box &box, NamedBox &constbox, Box &gradient, const bool enclosure) {
+    if (!run(box, constbox, enclosure, nvars_ > 0))
+        return false;
+    gradient.assign(grads_.begin() + result_ * nvars_, grads_.begin() + (result_ + 1) * nvars_);
+    X = regs_[result_];
+    return true;
+}
+
+// Executes the instructions. When partials is true, partial derivatives of each register are
+// computed right after its value. When trace is true, executed instructions are kept in trace_.
+// Otherwise, instructions that don't depend on the variables that changed since the base
+// evaluation (see base) are skipped. Domain errors set error_ and return false. Other errors,
+// e.g., a variable out of the box, throw Growl.
+
+bool CompiledExpr::run(const Box &box, NamedBox &constbox, const bool enclosure, const bool partials,
+        const bool trace) {
+    if (empty())
+        throw Growl("Kodiak (eval): evaluation of NotAReal is undefined");
+    if (trace)
+        trace_.clear();
+    if (slots_.size() != names_.size() || constbox.layout() != layout_)
+        resolve(constbox);
+    if (partials || trace)
+        synced_ = 0;
+    const Box *from = partials || trace ? NULL : base(box, enclosure);
+    cached_ = false;
+    if (from) {
+        changed_.assign(box.size(), false);
+        for (nat v = 0; v < box.size(); ++v)
+            changed_[v] = box[v].inf() != (*from)[v].inf() || box[v].sup() != (*from)[v].sup();
+        dirty_.assign(regs_.size(), false);
+    }
+    for (nat pc = 0; pc < code_.size(); ++pc) {
+        const Instruction &i = code_[pc];
+        if (from) {
+            if (!stale(i))
+                continue;
+            dirty_[i.dst] = true;
+        }
+        if (trace)
+            trace_.push_back(pc);
+        Interval &dst = regs_[i.dst];
+        switch (i.code) {
+            case VAR:
+                if (i.aux < box.size()) {
+                    dst = box[i.aux];
+                    break;
+                } else {
+                    std::ostringstream os;
+                    os << "Kodiak (eval): variable \"" << exprs_[i.ope1].name() << "\" is out of the box";
+                    throw Growl(os.str());
+                }
+            case NAME:
+            {
+                nat l = slots_[i.aux];
+                if (l < constbox.size()) {
+                    dst = constbox.val(l);
+                    break;
+                }
+                std::ostringstream os;
+                os << "Kodiak (eval): " << (i.ope1 ? "variable" : "constant") << " \"" << names_[i.aux] << "\" not found";
+                throw Growl(os.str());
+            }
+            case NEG:
+                dst = -regs_[i.ope1];
+                break;
+            case ABS:
+                dst = abs(regs_[i.ope1]);
+                break;
+            case SQ:
+                dst = sqr(regs_[i.ope1]);
+                break;
+            case SQRT:
+                if (regs_[i.ope1].plt(0))
+                    return domainError("Kodiak (eval): sqrt expects a nonnegative interval");
+                dst = sqrt(regs_[i.ope1]);
+                break;
+            case EXP:
+                dst = exp(regs_[i.ope1]);
+                break;
+            case LN:
+                if (regs_[i.ope1].ple(0))
+                    return domainError("Kodiak (eval): ln expects a positive interval");
+                dst = log(regs_[i.ope1]);
+                break;
+            case SIN:
+                dst = sin(regs_[i.ope1]);
+                break;
+            case COS:
+                dst = cos(regs_[i.ope1]);
+                break;
+            case TAN:
+                if (!(regs_[i.ope1].cgt(-Interval::PI() / Interval(2)) && regs_[i.ope1].clt(Interval::PI() / Interval(2))))
+                    return domainError("Kodiak (tan): tan expects a proper interval in [-pi/2,pi/2]");
+                dst = tan(regs_[i.ope1]);
+                break;
+            case ASIN:
+                if (!regs_[i.ope1].subset(Interval(-1, 1)))
+                    return domainError("Kodiak (eval): asin expects an interval in [-1,1]");
+                dst = asin(regs_[i.ope1]);
+                break;
+            case ACOS:
+                if (!regs_[i.ope1].subset(Interval(-1, 1)))
+                    return domainError("Kodiak (eval): acos expects an interval in [-1,1]");
+                dst = acos(regs_[i.ope1]);
+                break;
+            case ATAN:
+                dst = atan(regs_[i.ope1]);
+                break;
+            case SINGLE_ULP:
+                dst = SingleUlp(regs_[i.ope1]);
+                break;
+            case DOUBLE_ULP:
+                dst = DoubleUlp(regs_[i.ope1]);
+                break;
+            case DOUBLE_FEXP:
+                dst = DoubleFExp(regs_[i.ope1]);
+                break;
+            case ADD:
+                dst = regs_[i.ope1] + regs_[i.ope2];
+                break;
+            case SUB:
+                dst = regs_[i.ope1] - regs_[i.ope2];
+                break;
+            case MULT:
+                dst = regs_[i.ope1] * regs_[i.ope2];
+                break;
+            case DIVISOR:
+                if (regs_[i.ope1].contains(0))
+                    return domainError("Kodiak (eval): division by an interval that contains zero");
+                break;
+            case DIV:
+                dst = regs_[i.ope1] / regs_[i.ope2];
+                break;
+            case POW:
+                dst = power(regs_[i.ope1], i.aux);
+                break;
+            case ERROR:
+            {
+                real maxAbsoluteError = regs_[i.ope2].sup();
+                dst = regs_[i.ope1] + Interval(-maxAbsoluteError, maxAbsoluteError);
+                break;
+            }
+            case FLOOR:
+                dst = Interval(std::floor(regs_[i.ope1].inf()), std::floor(regs_[i.ope1].sup()));
+                break;
+            case MAX:
+                dst = Interval(std::max(regs_[i.ope1].inf(), regs_[i.ope2].inf()),
+                        std::max(regs_[i.ope1].sup(), regs_[i.ope2].sup()));
+                break;
+            case MIN:
+                dst = Interval(std::min(regs_[i.ope1].inf(), regs_[i.ope2].inf()),
+                        std::min(regs_[i.ope1].sup(), regs_[i.ope2].sup()));
+                break;
+            case LET:
+                // Local variables are bound to registers, but the name cannot hide a constant
+                if (slots_[i.aux] < constbox.size()) {
+                    std::ostringstream os;
+                    os << "Kodiak (push): name \"" << names_[i.aux] << "\" already exists in named box";
+                    throw Growl(os.str());
+                }
+                break;
+            case IFNZ:
+                if (regs_[i.ope1].clt(0))
+                    break;
+                if (regs_[i.ope1].cgt(0)) {
+                    pc = i.aux - 1;
+                    break;
+                }
+                return domainError("Kodiak (eval): ifnz cannot be evaluated when the first argument is an interval containing zero");
+            case JUMP:
+                pc = i.aux - 1;
+                break;
+            case MOVE:
+                dst = regs_[i.ope1];
+                break;
+            case CALL:
+            {
+                const Call &call = calls_[i.aux];
+                if (call.scope.empty()) {
+                    try {
+                        dst = exprs_[call.expr].eval(box, constbox, enclosure && call.enclosure);
+                    } catch (Growl const &growl) {
+                        return domainError(growl.what());
+                    }
+                    break;
+                }
+                for (nat k = 0; k < call.scope.size(); ++k)
+                    constbox.push(names_[call.scope[k].first], regs_[call.scope[k].second]);
+                try {
+                    dst = exprs_[call.expr].eval(box, constbox, enclosure && call.enclosure);
+                } catch (Growl const &growl) {
+                    for (nat k = 0; k < call.scope.size(); ++k)
+                        constbox.pop();
+                    return domainError(growl.what());
+                }
+                for (nat k = 0; k < call.scope.size(); ++k)
+                    constbox.pop();
+                break;
+            }
+            case FAIL:
+                return domainError(messages_[i.aux]);
+        }
+        if (partials)
+            derive(i, box, constbox, enclosure);
+    }
+    box_ = box;
+    enclosure_ = enclosure;
+    cached_ = true;
+    return true;
+}
+
+// Box of the evaluation whose registers are reused by an incremental evaluation on box, i.e.,
+// the top of the stack of pushEnclosures or, when it is empty, the last evaluation. Registers
+// of the former are restored in regs_: when regs_ already come from them, only the registers
+// written by the last evaluation are copied. Returns NULL when every instruction has to be run.
+
+const Box *CompiledExpr::base(const Box &box, const bool enclosure) {
+    nat synced = synced_;
+    synced_ = 0;
+    if (!straight_)
+        return NULL;
+    if (!saved_.empty()) {
+        const Enclosures &top = saved_.back();
+        if (!top.valid || top.enclosure != enclosure || top.box.size() != box.size())
+            return NULL;
+        if (synced == top.id) {
+            for (nat r = 0; r < dirty_.size(); ++r) {
+                if (dirty_[r])
+                    regs_[r] = top.regs[r];
+            }
+        } else
+            regs_ = top.regs;
+        synced_ = top.id;
+        return &top.box;
+    }
+    if (!cached_ || enclosure_ != enclosure || box_.size() != box.size())
+        return NULL;
+    return &box_;
+}
+
+// True if instruction i has to be run again, i.e., it depends on a changed variable, on a register
+// written by the current evaluation, or on names of the named box
+
+bool CompiledExpr::stale(const Instruction &i) {
+    switch (i.code) {
+        case VAR:
+            return i.aux >= changed_.size() || changed_[i.aux];
+        case NAME:
+        case LET:
+        case FAIL:
+            return true;
+        case CALL:
+        {
+            const Call &call = calls_[i.aux];
+            if (call.named)
+                return true;
+            const VarBag &vars = exprs_[call.expr].vars();
+            for (VarBag::iterator it = vars.begin(); it != vars.end(); ++it) {
+                if (it->first >= changed_.size() || changed_[it->first])
+                    return true;
+            }
+            return false;
+        }
+        case ADD:
+        case SUB:
+        case MULT:
+        case DIV:
+        case ERROR:
+        case MAX:
+        case MIN:
+            return dirty_[i.ope1] || dirty_[i.ope2];
+        default:
+            return dirty_[i.ope1];
+    }
+}
+
+void CompiledExpr::pushEnclosures() {
+    Enclosures e;
+    e.id = ++pushes_;
+    e.valid = cached_ && straight_;
+    e.enclosure = enclosure_;
+    if (e.valid) {
+        e.box = box_;
+        e.regs = regs_;
+    }
+    saved_.push_back(e);
+}
+
+void CompiledExpr::popEnclosures() {
+    if (!saved_.empty())
+        saved_.pop_back();
+}
+
+// Names are looked up in the named box once per layout, so that evaluation reads them by index
+
+void CompiledExpr::resolve(const NamedBox &constbox) {
+    slots_.resize(names_.size());
+    for (nat k = 0; k < names_.size(); ++k)
+        slots_[k] = constbox.var(names_[k]);
+    layout_ = constbox.layout();
+}
+
+bool CompiledExpr::domainError(const std::string &msg) {
+    error_ = msg;
+    return false;
+}
+
+void CompiledExpr::differentiate(const nat n, const Substitution &sigma) {
+    nvars_ = n;
+    grads_.assign(regs_.size() * n, Interval(0));
+    namePartials_.clear();
+    callPartials_.assign(calls_.size(), Realn());
+    if (n == 0)
+        return;
+    for (nat pc = 0; pc < code_.size(); ++pc) {
+        Instruction &i = code_[pc];
+        if (i.code != NAME || !i.ope1)
+            continue;
+        i.ope2 = namePartials_.size();
+        for (nat v = 0; v < n; ++v) {
+            std::ostringstream os;
+            os << "d" << names_[i.aux] << "/d" << var_name(v);
+            Partial p = {true, 0, Interval(0)};
+            Substitution::const_iterator it = sigma.find(os.str());
+            if (it == sigma.end())
+                p.name = name(os.str());
+            else if (it->second.isName())
+                p.name = name(it->second.name());
+            else {
+                p.named = false;
+                p.val = it->second.isVal() ? it->second.val() : Interval(Interval::ENTIRE());
+            }
+            namePartials_.push_back(p);
+        }
+    }
+    // Polynomials and rationals are differentiated symbolically, unless they depend on names
+    for (nat k = 0; k < calls_.size(); ++k) {
+        const Real &e = exprs_[calls_[k].expr];
+        if (!calls_[k].scope.empty() || e.open())
+            continue;
+        callPartials_[k].resize(n);
+        for (nat v = 0; v < n; ++v) {
+            if (e.hasVar(v))
+                callPartials_[k][v] = e.deriv(v);
+        }
+    }
+}
+
+namespace {
+
+    bool isNull(const Interval &i) {
+        return i.inf() == 0 && i.sup() == 0;
+    }
+
+    // Partial derivative d times factor f
+    Interval scale(const Interval &d, const Interval &f) {
+        if (isNull(d) || isNull(f))
+            return Interval(0);
+        return d * f;
+    }
+
+    // Partial derivative d divided by q
+    Interval quotient(const Interval &d, const Interval &q) {
+        if (isNull(d))
+            return Interval(0);
+        if (q.contains(0))
+            return Interval::ENTIRE();
+        return d / q;
+    }
+
+    // Partial derivative through a function that is not differentiable
+    Interval nondifferentiable(const Interval &d) {
+        return isNull(d) ? Interval(0) : Interval(Interval::ENTIRE());
+    }
+}
+
+// Sets the partial derivatives of the register written by instruction i. Operands that are
+// registers have already been differentiated.
+
+void CompiledExpr::derive(const Instruction &i, const Box &box, NamedBox &constbox, const bool enclosure) {
+    Interval *dst = &grads_[i.dst * nvars_];
+    const Interval *d1 = &grads_[0];
+    const Interval *d2 = &grads_[0];
+    switch (i.code) {
+        case VAR:
+            for (nat v = 0; v < nvars_; ++v)
+                dst[v] = Interval(v == i.aux ? 1 : 0);
+            return;
+        case NAME:
+            for (nat v = 0; v < nvars_; ++v) {
+                if (!i.ope1) {
+                    dst[v] = Interval(0);
+                    continue;
+                }
+                const Partial &p = namePartials_[i.ope2 + v];
+                if (!p.named) {
+                    dst[v] = p.val;
+                    continue;
+                }
+                nat l = slots_[p.name];
+                dst[v] = l < constbox.size() ? constbox.val(l) : Interval(Interval::ENTIRE());
+            }
+            return;
+        case CALL:
+        {
+            const Call &call = calls_[i.aux];
+            const Realn &partials = callPartials_[i.aux];
+            for (nat v = 0; v < nvars_; ++v) {
+                if (partials.empty()) {
+                    dst[v] = Interval::ENTIRE();
+                    continue;
+                }
+                if (partials[v].notAReal()) {
+                    dst[v] = Interval(0);
+                    continue;
+                }
+                try {
+                    dst[v] = partials[v].eval(box, constbox, enclosure && call.enclosure);
+                } catch (Growl const &) {
+                    dst[v] = Interval::ENTIRE();
+                }
+            }
+            return;
+        }
+        case DIVISOR:
+        case LET:
+        case IFNZ:
+        case JUMP:
+        case FAIL:
+            return;
+        default:
+            d1 += i.ope1 * nvars_;
+            d2 += i.ope2 * nvars_;
+    }
+    const Interval &x = regs_[i.ope1];
+    const Interval &y = regs_[i.ope2];
+    const Interval &f = regs_[i.dst];
+    for (nat v = 0; v < nvars_; ++v) {
+        switch (i.code) {
+            case NEG:
+                dst[v] = -d1[v];
+                break;
+            case ABS:
+                dst[v] = x.cgt(0) ? d1[v] : x.clt(0) ? Interval(-d1[v]) : scale(d1[v], Interval(-1, 1));
+                break;
+            case SQ:
+                dst[v] = scale(d1[v], Interval(2) * x);
+                break;
+            case SQRT:
+                dst[v] = quotient(d1[v], Interval(2) * f);
+                break;
+            case EXP:
+                dst[v] = scale(d1[v], f);
+                break;
+            case LN:
+                dst[v] = quotient(d1[v], x);
+                break;
+            case SIN:
+                dst[v] = scale(d1[v], cos(x));
+                break;
+            case COS:
+                dst[v] = scale(d1[v], -sin(x));
+                break;
+            case TAN:
+                dst[v] = quotient(d1[v], sqr(cos(x)));
+                break;
+            case ASIN:
+                dst[v] = quotient(d1[v], sqrt(Interval(1) - sqr(x)));
+                break;
+            case ACOS:
+                dst[v] = -quotient(d1[v], sqrt(Interval(1) - sqr(x)));
+                break;
+            case ATAN:
+                dst[v] = quotient(d1[v], Interval(1) + sqr(x));
+                break;
+            case SINGLE_ULP:
+            case DOUBLE_ULP:
+                dst[v] = nondifferentiable(d1[v]);
+                break;
+            case DOUBLE_FEXP:
+                // Not the derivative, but it has the same sign (see RealUnary_Node::deriv)
+                dst[v] = d1[v];
+                break;
+            case ADD:
+                dst[v] = d1[v] + d2[v];
+                break;
+            case SUB:
+                dst[v] = d1[v] - d2[v];
+                break;
+            case MULT:
+                dst[v] = scale(d1[v], y) + scale(d2[v], x);
+                break;
+            case DIV:
+                dst[v] = quotient(d1[v] - scale(d2[v], f), y);
+                break;
+            case POW:
+                dst[v] = i.aux == 0 ? Interval(0) : scale(d1[v], Interval(i.aux) * power(x, i.aux - 1));
+                break;
+            case ERROR:
+                dst[v] = nondifferentiable(isNull(d1[v]) ? d2[v] : d1[v]);
+                break;
+            case FLOOR:
+                dst[v] = nondifferentiable(d1[v]);
+                break;
+            case MAX:
+            case MIN:
+                dst[v] = d1[v].hull(d2[v]);
+                break;
+            case MOVE:
+                dst[v] = d1[v];
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+namespace {
+
+    // Intersects x with y. Returns false when the intersection is empty
+    bool narrow(Interval &x, const Interval &y) {
+        real lo = std::max(x.inf(), y.inf());
+        real hi = std::min(x.sup(), y.sup());
+        if (lo > hi)
+            return false;
+        x = Interval(lo, hi);
+        return true;
+    }
+}
+
+bool CompiledExpr::contract(Box &box, NamedBox &constbox, const Interval &target, const bool enclosure) {
+    if (!run(box, constbox, enclosure, false, true))
+        return true;
+    // Registers of constants are projected in proj_, so that regs_ keeps their values
+    proj_ = regs_;
+    if (!narrow(proj_[result_], target))
+        return false;
+    for (nat k = trace_.size(); k > 0; --k) {
+        if (!project(code_[trace_[k - 1]]))
+            return false;
+    }
+    for (nat k = 0; k < trace_.size(); ++k) {
+        const Instruction &i = code_[trace_[k]];
+        if (i.code == VAR && i.aux < box.size() && !narrow(box[i.aux], proj_[i.dst]))
+            return false;
+    }
+    return true;
+}
+
+namespace {
+
+    const real infinity = std::numeric_limits<real>::infinity();
+
+    // Nonnegative n-th root of a nonnegative interval
+    Interval root(const Interval &z, const nat n) {
+        if (n == 2)
+            return sqrt(z);
+        real lo = z.inf() > 0 ? exp(log(Interval(z.inf(), z.inf())) / Interval(n)).inf() : 0;
+        real hi = std::isinf(z.sup()) ? infinity :
+                z.sup() > 0 ? exp(log(Interval(z.sup(), z.sup())) / Interval(n)).sup() : 0;
+        return Interval(lo, hi);
+    }
+
+    // n-th root, for odd n
+    Interval oddRoot(const Interval &z, const nat n) {
+        real lo = z.inf() >= 0 ? root(Interval(z.inf(), z.inf()), n).inf() : -root(Interval(-z.inf(), -z.inf()), n).sup();
+        real hi = z.sup() >= 0 ? root(Interval(z.sup(), z.sup()), n).sup() : -root(Interval(-z.sup(), -z.sup()), n).inf();
+        return Interval(lo, hi);
+    }
+
+    // Narrows x to the points whose absolute value is in r
+    bool narrowAbs(Interval &x, const Interval &r) {
+        Interval pos = x;
+        Interval neg = x;
+        bool p = narrow(pos, r);
+        bool n = narrow(neg, -r);
+        if (!p && !n)
+            return false;
+        x = !n ? pos : !p ? neg : Interval(neg.hull(pos));
+        return true;
+    }
+}
+
+// Narrows the operands of instruction i to the points where its value is in the projection of
+// its register
+
+bool CompiledExpr::project(const Instruction &i) {
+    switch (i.code) {
+        case VAR:
+        case NAME:
+        case CALL:
+        case DIVISOR:
+        case LET:
+        case IFNZ:
+        case JUMP:
+        case FAIL:
+            return true;
+        default:
+            break;
+    }
+    const Interval z = proj_[i.dst];
+    Interval &x = proj_[i.ope1];
+    Interval &y = proj_[i.ope2];
+    switch (i.code) {
+        case NEG:
+            return narrow(x, -z);
+        case ABS:
+        {
+            Interval r = z;
+            return narrow(r, Interval(0, infinity)) && narrowAbs(x, r);
+        }
+        case SQ:
+        {
+            Interval r = z;
+            return narrow(r, Interval(0, infinity)) && narrowAbs(x, sqrt(r));
+        }
+        case POW:
+        {
+            if (i.aux == 0)
+                return true;
+            if (i.aux == 1)
+                return narrow(x, z);
+            if (i.aux % 2 == 1)
+                return narrow(x, oddRoot(z, i.aux));
+            Interval r = z;
+            return narrow(r, Interval(0, infinity)) && narrowAbs(x, root(r, i.aux));
+        }
+        case SQRT:
+        {
+            Interval r = z;
+            return narrow(r, Interval(0, infinity)) && narrow(x, sqr(r));
+        }
+        case EXP:
+            if (z.sup() <= 0)
+                return false;
+            return narrow(x, Interval(z.inf() > 0 ? log(Interval(z.inf(), z.inf())).inf() : -infinity,
+                    log(Interval(z.sup(), z.sup())).sup()));
+        case LN:
+            return narrow(x, exp(z));
+        case ASIN:
+            return narrow(x, sin(z));
+        case ACOS:
+            return narrow(x, cos(z));
+        case ATAN:
+            return narrow(x, tan(z));
+        case ADD:
+            return narrow(x, z - y) && narrow(y, z - x);
+        case SUB:
+            return narrow(x, z + y) && narrow(y, x - z);
+        case MULT:
+            if (!y.contains(0) && !narrow(x, z / y))
+                return false;
+            return x.contains(0) || narrow(y, z / x);
+        case DIV:
+            if (!narrow(x, z * y))
+                return false;
+            return z.contains(0) || narrow(y, x / z);
+        case MAX:
+            return narrow(x, Interval(-infinity, z.sup())) && narrow(y, Interval(-infinity, z.sup()));
+        case MIN:
+            return narrow(x, Interval(z.inf(), infinity)) && narrow(y, Interval(z.inf(), infinity));
+        case MOVE:
+            return narrow(x, z);
+        default:
+            // Sine, cosine, tangent, floor, error, and ulp functions are not projected
+            return true;
+    }
+}
+
+void CompiledExpr::print(std::ostream &os) const {
+    static const char *codes[] = {
+        "var", "name", "neg", "abs", "sq", "sqrt", "exp", "ln", "sin", "cos", "tan", "asin", "acos", "atan",
+        "sulp", "dulp", "dfexp", "add", "sub", "mult", "divisor", "div", "pow", "error", "floor",
+        "max", "min", "let", "ifnz", "jump", "move", "call", "fail"
+    };
+    for (nat pc = 0; pc < code_.size(); ++pc) {
+        const Instruction &i = code_[pc];
+        os << pc << ": r" << i.dst << " = " << codes[i.code];
+        switch (i.code) {
+            case VAR: os << " " << exprs_[i.ope1];
+                break;
+            case NAME:
+            case LET: os << " " << names_[i.aux];
+                break;
+            case CALL: os << " " << exprs_[calls_[i.aux].expr];
+                break;
+            case FAIL: os << " \"" << messages_[i.aux] << "\"";
+                break;
+            case IFNZ: os << " r" << i.ope1 << " " << i.aux;
+                break;
+            case JUMP: os << " " << i.aux;
+                break;
+            case POW: os << " r" << i.ope1 << " " << i.aux;
+                break;
+            case ADD:
+            case SUB:
+            case MULT:
+            case DIV:
+            case ERROR:
+            case MAX:
+            case MIN: os << " r" << i.ope1 << " r" << i.ope2;
+                break;
+            default: os << " r" << i.ope1;
+        }
+        os << std::endl;
+    }
+    os << "result: r" << result_ << std::endl;
+}
+
+std::ostream &kodiak::operator<<(std::ostream &os, const CompiledExpr &e) {
+    e.print(os);
+    return os;
+}
@@ -0,0 +1,214 @@
+#ifndef KODIAK_COMPILED_EXPR
+#define KODIAK_COMPILED_EXPR
+
+#include "Real.hpp"
+
+namespace kodiak {
+
+    /* CompiledExpr
+     *
+     * Interval evaluation of an indexed Real expression as a flat sequence of
+     * instructions on a register file. Each node of the expression DAG is
+     * evaluated once per call, local variables of let expressions are bound to
+     * registers, and ifnz expressions are compiled into conditional jumps.
+     * Polynomial and rational expressions are evaluated by Real::eval, so that
+     * they keep their Bernstein coefficients from one evaluation to the next.
+     * The result of eval is the same as the result of Real::eval on the
+     * compiled expression. Domain errors, e.g., the square root of a negative
+     * interval, are reported by tryEval as a status, without throwing an exception.
+     * A CompiledExpr shares nodes with the expression it was compiled from, but
+     * it has its own register file and cannot be evaluated from two threads at
+     * the same time.
+     *
+     * Once differentiate has been called, eval can also enclose the partial
+     * derivatives of the expression in the same sweep (forward-mode automatic
+     * differentiation). Partial derivatives that cannot be enclosed, e.g., through
+     * floor or a division by an interval that contains zero, are the entire real line.
+     *
+     * contract narrows a box to the points where the expression may take values in
+     * a target interval, by a forward evaluation followed by a backward projection on
+     * the operands of each instruction. Polynomials are only narrowed through their
+     * monomials when the expression is compiled with expand set to true.
+     *
+     * Registers are kept from one evaluation to the next. When the box only differs from
+     * the box of a previous evaluation in a few variables, eval only runs the instructions
+     * that depend on those variables or on names of the named box. pushEnclosures keeps the
+     * registers of the last evaluation, e.g., the one of the parent node of a branch and bound
+     * search, so that the evaluations of its sub-boxes start from them until popEnclosures
+     * is called. Expressions with ifnz are always evaluated from scratch.
+     */
+
+    class CompiledExpr {
+    public:
+
+        CompiledExpr() : result_(0), layout_(0), nvars_(0), straight_(true), cached_(false), enclosure_(false),
+        pushes_(0), synced_(0) {
+        }
+
+        explicit CompiledExpr(const Real &e, const bool expand = false) : result_(0), layout_(0), nvars_(0),
+        straight_(true), cached_(false), enclosure_(false), pushes_(0), synced_(0) {
+            compile(e, expand);
+        }
+
+        // If expand is true, polynomials are compiled as sums of monomials instead of being
+        // evaluated by Real::eval
+        void compile(const Real &, const bool expand = false);
+
+        bool empty() const {
+            return expr_.notAReal();
+        }
+
+        // Number of instructions
+        nat size() const {
+            return code_.size();
+        }
+
+        const Real &expr() const {
+            return expr_;
+        }
+
+        Interval eval(const Box &box = EmptyBox, const bool enclosure = false) {
+            NamedBox constbox;
+            return eval(box, constbox, enclosure);
+        }
+        Interval eval(const Box &, NamedBox &, const bool = false);
+
+        // Prepares the evaluation of the partial derivatives with respect to the first n variables.
+        // The partial derivative of a local name "y" with respect to variable x is the value of
+        // "dy/dx" in the substitution, when it is constant, or in the constant box of eval
+        void differentiate(const nat n, const Substitution & = EmptySubstitution);
+
+        // Number of partial derivatives computed by eval
+        nat partials() const {
+            return nvars_;
+        }
+
+        // Same as eval, but also sets gradient to the enclosures of the partial derivatives
+        // of the expression. Gradient is not modified when the evaluation fails.
+        Interval eval(const Box &, NamedBox &, Box &gradient, const bool = false);
+
+        // Same as eval, but domain errors (e.g., the square root of a negative interval or a
+        // division by an interval that contains zero) return false instead of throwing Growl,
+        // and the message is kept in error(). X and gradient are not modified in that case.
+        bool tryEval(Interval &X, const Box &, NamedBox &, const bool = false);
+        bool tryEval(Interval &X, const Box &, NamedBox &, Box &gradient, const bool = false);
+
+        // Message of the last domain error
+        const std::string &error() const {
+            return error_;
+        }
+
+        // Forward-backward (HC4) contraction. Narrows box to a sub-box that contains all the
+        // points of box where the value of the expression is in target. Returns false if there
+        // is no such point. The box is not modified when the evaluation fails.
+        bool contract(Box &, NamedBox &, const Interval &target, const bool = false);
+
+        // Enclosure cache along the path of a search (see above)
+        void pushEnclosures();
+        void popEnclosures();
+
+        void print(std::ostream & = std::cout) const;
+
+    private:
+
+        enum Code {
+            VAR, NAME, NEG, ABS, SQ, SQRT, EXP, LN, SIN, COS, TAN, ASIN, ACOS, ATAN,
+            SINGLE_ULP, DOUBLE_ULP, DOUBLE_FEXP, ADD, SUB, MULT, DIVISOR, DIV, POW, ERROR, FLOOR,
+            MAX, MIN, LET, IFNZ, JUMP, MOVE, CALL, FAIL
+        };
+
+        struct Instruction {
+            Code code;
+            nat dst; // Destination register
+            nat ope1; // First operand register (index in exprs_ for VAR, local flag for NAME)
+            nat ope2; // Second operand register
+            nat aux; // Variable index, exponent, jump target, or index in names_, calls_, or messages_
+        };
+
+        // Local variable bound to a register
+        typedef std::pair<nat, nat> Binding; // (index in names_, register)
+        typedef std::vector<Binding> Scope;
+
+        struct Call {
+            nat expr; // Index in exprs_
+            bool enclosure; // Enclosure flag of the expression
+            Scope scope; // Local variables visible from the expression, outermost first
+            bool named; // The expression refers to names, which are looked up at each evaluation
+        };
+
+        // Registers of an evaluation, together with the box and the enclosure flag it was run on
+        struct Enclosures {
+            nat id; // Order of the push, see synced_
+            bool valid;
+            bool enclosure;
+            Box box;
+            Box regs;
+        };
+
+        // Key of an evaluated node: node, let scope (0 for closed expressions), and enclosure flag
+        typedef std::pair<std::pair<const Node *, nat>, bool> Key;
+        typedef std::map<Key, nat> Memo;
+
+        // Partial derivative of a local name
+        struct Partial {
+            bool named; // Value of names_[name] in the constant box, otherwise val
+            nat name;
+            Interval val;
+        };
+
+        struct Compiler {
+            Scope scope; // Let bindings in scope, outermost first
+            nat scopeId; // Identifier of the innermost let scope
+            nat scopes; // Number of let scopes created so far
+            Memo memo; // Registers of evaluated nodes
+            bool expand; // Polynomials are compiled as sums of monomials
+        };
+
+        nat compile(const Real &, Compiler &, const bool);
+        nat compileNode(const Real &, Compiler &, const bool);
+        nat compileCall(const Real &, Compiler &, const bool);
+        nat compileMonomials(const Real &, Compiler &, const bool);
+        nat emit(const Code, const nat = 0, const nat = 0, const nat = 0);
+        nat fail(const std::string &);
+        nat name(const std::string &);
+        nat reg(const Interval & = Interval());
+        bool run(const Box &, NamedBox &, const bool, const bool, const bool = false);
+        void resolve(const NamedBox &);
+        const Box *base(const Box &, const bool);
+        bool stale(const Instruction &);
+        bool domainError(const std::string &);
+        void derive(const Instruction &, const Box &, NamedBox &, const bool);
+        bool project(const Instruction &);
+
+        Real expr_; // Compiled expression
+        std::vector<Instruction> code_;
+        Box regs_; // Register file. Registers of constants are set at compilation time
+        nat result_; // Register of the result
+        Names names_; // Names of constants and local variables
+        std::vector<nat> slots_; // Index of each name in a named box with layout layout_
+        nat layout_;
+        Realn exprs_; // Variables and opaque subexpressions
+        std::vector<Call> calls_;
+        std::vector<std::string> messages_; // Error messages of FAIL instructions
+        std::string error_; // Message of the last domain error
+        nat nvars_; // Number of partial derivatives
+        Box grads_; // Partial derivatives of the registers, nvars_ per register
+        std::vector<Partial> namePartials_; // Partial derivatives of local names, nvars_ per NAME instruction
+        std::vector<Realn> callPartials_; // Partial derivatives of closed calls (NotAReal when zero)
+        std::vector<nat> trace_; // Instructions executed by the last traced run
+        Box proj_; // Projections of the registers during contraction
+        bool straight_; // No jumps, so that each evaluation runs every instruction
+        bool cached_; // regs_ are the registers of an evaluation on box_
+        bool enclosure_; // Enclosure flag of that evaluation
+        Box box_;
+        std::vector<Enclosures> saved_; // Stack of pushEnclosures
+        Bools changed_; // Variables whose enclosures differ from the base of an incremental evaluation
+        Bools dirty_; // Registers written by an incremental evaluation
+        nat pushes_; // Number of calls to pushEnclosures
+        nat synced_; // Id of the saved enclosures whose registers are regs_, except those in dirty_ (0 if none)
+    };
+
+    std::ostream &operator<<(std::ostream &, const CompiledExpr &);
+}
+
+#endif // KODIAK_COMPILED_EXPR
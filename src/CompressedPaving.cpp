@@ -0,0 +1,412 @@
+#include "CompressedPaving.hpp"
+
+#include <cstring>
+
+using namespace kodiak;
+
+const uint32_t CompressedPaving::VERSION;
+
+namespace {
+
+    const char CompressedMagic[4] = {'K', 'C', 'P', 'V'};
+    const uint32_t ByteOrderMark = 0x01020304;
+
+    // Bits needed to write the numbers 0 to n - 1
+    nat bitsFor(const nat n) {
+        nat bits = 0;
+        while (bits < 32 && (1u << bits) < n)
+            ++bits;
+        return bits;
+    }
+
+    template <typename T>
+    void writeRaw(std::ofstream &f, const T &t) {
+        f.write(reinterpret_cast<const char *> (&t), sizeof (T));
+    }
+
+    template <typename T>
+    void readRaw(std::ifstream &f, T &t) {
+        f.read(reinterpret_cast<char *> (&t), sizeof (T));
+    }
+
+    void writeBoxes(std::ofstream &f, const Boxes &boxes, const nat nvars) {
+        writeRaw(f, (uint64_t) boxes.size());
+        for (nat k = 0; k < boxes.size(); ++k) {
+            for (nat v = 0; v < nvars; ++v) {
+                writeRaw(f, (double) boxes[k][v].inf());
+                writeRaw(f, (double) boxes[k][v].sup());
+            }
+        }
+    }
+
+    void readBoxes(std::ifstream &f, Boxes &boxes, const nat nvars) {
+        uint64_t size = 0;
+        readRaw(f, size);
+        boxes.clear();
+        for (uint64_t k = 0; f && k < size; ++k) {
+            Box box(nvars);
+            for (nat v = 0; v < nvars; ++v) {
+                double lb = 0, ub = 0;
+                readRaw(f, lb);
+                readRaw(f, ub);
+                box[v] = Interval(lb, ub);
+            }
+            boxes.push_back(box);
+        }
+    }
+
+    void corrupted(const std::string &filename, const std::string &what) {
+        std::ostringstream os;
+        os << "Kodiak (CompressedPaving): file \"" << filename << "\" " << what;
+        throw Growl(os.str());
+    }
+}
+
+CompressedPaving::CompressedPaving(const Paving &paving) : type_(paving.type()), varbox_(paving.varbox()),
+sizes_(paving.ntypes(), 0), nbits_(0), nodes_(0), varBits_(bitsFor(paving.nvars())),
+typeBits_(bitsFor(paving.ntypes())), others_(paving.ntypes()), roots_(paving.roots()) {
+    std::vector<Node> tree(1, Node{-1, -1, 0});
+    for (nat i = 0; i < paving.ntypes(); ++i) {
+        for (nat k = 0; k < paving.size(i); ++k) {
+            const Box &box = paving.boxes(i)[k];
+            if (bisection(box) && !overlaps(tree, box))
+                insert(tree, box, i);
+            else
+                others_[i].push_back(box);
+        }
+    }
+    collapse(tree, 0);
+    encode(tree, 0);
+    for (nat i = 0; i < others_.size(); ++i)
+        sizes_[i] += others_[i].size();
+}
+
+// True if the box is obtained by bisection of the initial box, i.e., each of its intervals is
+// reached by halving the interval of the initial box
+
+bool CompressedPaving::bisection(const Box &box) const {
+    if (box.size() != nvars())
+        return false;
+    for (nat v = 0; v < box.size(); ++v) {
+        Interval x = varbox_.val(v);
+        while (x.inf() != box[v].inf() || x.sup() != box[v].sup()) {
+            real mid = x.mid();
+            if (!(x.inf() < mid && mid < x.sup()))
+                return false;
+            if (box[v].sup() <= mid)
+                x = Interval(x.inf(), mid);
+            else if (box[v].inf() >= mid)
+                x = Interval(mid, x.sup());
+            else
+                return false;
+        }
+    }
+    return true;
+}
+
+// True if the box overlaps a leaf of the tree, i.e., a box already inserted. Boxes of a paving
+// built with push_box may overlap.
+
+bool CompressedPaving::overlaps(const std::vector<Node> &tree, const Box &box) const {
+    std::vector<std::pair<nat, std::pair<Box, Box> > > stack;
+    stack.push_back(std::make_pair(0u, std::make_pair(varbox_.box(), box)));
+    while (!stack.empty()) {
+        nat n = stack.back().first;
+        Box node = stack.back().second.first;
+        Box part = stack.back().second.second;
+        stack.pop_back();
+        if (tree[n].type >= 0)
+            return true;
+        if (tree[n].var < 0)
+            continue;
+        nat v = tree[n].var;
+        Interval x = node[v];
+        real mid = x.mid();
+        if (part[v].inf() < mid) {
+            node[v] = Interval(x.inf(), mid);
+            Box left = part;
+            left[v] = Interval(part[v].inf(), std::min(part[v].sup(), mid));
+            stack.push_back(std::make_pair(tree[n].child, std::make_pair(node, left)));
+        }
+        if (part[v].sup() > mid) {
+            node[v] = Interval(mid, x.sup());
+            part[v] = Interval(std::max(part[v].inf(), mid), part[v].sup());
+            stack.push_back(std::make_pair(tree[n].child + 1, std::make_pair(node, part)));
+        }
+    }
+    return false;
+}
+
+// Marks as leaves of type i the nodes that cover the box. Nodes are split as needed, first on
+// the variable of smallest index where the box differs from the node. A box that spans both
+// children of a split is inserted in each of them. The box must not overlap the leaves.
+
+void CompressedPaving::insert(std::vector<Node> &tree, const Box &box, const nat i) {
+    // Nodes to visit, with their boxes and the part of the box that they cover
+    std::vector<std::pair<nat, std::pair<Box, Box> > > stack;
+    stack.push_back(std::make_pair(0u, std::make_pair(varbox_.box(), box)));
+    while (!stack.empty()) {
+        nat n = stack.back().first;
+        Box node = stack.back().second.first;
+        Box part = stack.back().second.second;
+        stack.pop_back();
+        if (tree[n].var < 0) {
+            nat v = 0;
+            while (v < part.size() && part[v].inf() == node[v].inf() && part[v].sup() == node[v].sup())
+                ++v;
+            if (v == part.size()) {
+                tree[n].type = i;
+                continue;
+            }
+            tree[n].var = v;
+            tree[n].child = tree.size();
+            tree.push_back(Node{-1, -1, 0});
+            tree.push_back(Node{-1, -1, 0});
+        }
+        nat v = tree[n].var;
+        nat child = tree[n].child;
+        Interval x = node[v];
+        real mid = x.mid();
+        bool both = part[v].inf() < mid && part[v].sup() > mid;
+        if (part[v].inf() < mid) {
+            node[v] = Interval(x.inf(), mid);
+            Box left = part;
+            if (both)
+                left[v] = node[v];
+            stack.push_back(std::make_pair(child, std::make_pair(node, left)));
+        }
+        if (part[v].sup() > mid) {
+            node[v] = Interval(mid, x.sup());
+            if (both)
+                part[v] = node[v];
+            stack.push_back(std::make_pair(child + 1, std::make_pair(node, part)));
+        }
+    }
+}
+
+// Sibling leaves of the same type, and sibling empty nodes, are collapsed into their parent
+
+void CompressedPaving::collapse(std::vector<Node> &tree, const nat n) {
+    if (tree[n].var < 0)
+        return;
+    nat child = tree[n].child;
+    collapse(tree, child);
+    collapse(tree, child + 1);
+    if (tree[child].var < 0 && tree[child + 1].var < 0 && tree[child].type == tree[child + 1].type) {
+        tree[n].var = -1;
+        tree[n].type = tree[child].type;
+    }
+}
+
+void CompressedPaving::encode(const std::vector<Node> &tree, const nat n) {
+    ++nodes_;
+    if (tree[n].var >= 0) {
+        write(1, 1);
+        write(tree[n].var, varBits_);
+        encode(tree, tree[n].child);
+        encode(tree, tree[n].child + 1);
+    } else if (tree[n].type >= 0) {
+        write(2, 2);
+        write(tree[n].type, typeBits_);
+        ++sizes_[tree[n].type];
+    } else
+        write(0, 2);
+}
+
+// True if the bits from pos are a tree of variables and types of this paving. Nodes are read in
+// preorder, so the tree is complete once every split has been followed by its two children.
+
+bool CompressedPaving::valid(uint64_t &pos) const {
+    uint64_t pending = 1; // Nodes still to be read
+    while (pending > 0) {
+        if (pos + 1 > nbits_)
+            return false;
+        if (read(pos, 1)) {
+            if (pos + varBits_ > nbits_ || read(pos, varBits_) >= nvars())
+                return false;
+            ++pending;
+            continue;
+        }
+        if (pos + 1 > nbits_)
+            return false;
+        if (read(pos, 1) && (pos + typeBits_ > nbits_ || read(pos, typeBits_) >= ntypes()))
+            return false;
+        --pending;
+    }
+    return true;
+}
+
+// The tree is walked with an explicit path of splits, since its depth is only bounded by the
+// bits of the paving
+
+void CompressedPaving::decode(uint64_t &pos, Box &box, const Callback &callback) const {
+    struct Split {
+        nat var;
+        Interval x; // Interval of the variable before the split
+        bool second; // True once the second child is being decoded
+    };
+    std::vector<Split> path;
+    do {
+        if (read(pos, 1)) {
+            nat v = read(pos, varBits_);
+            path.push_back(Split{v, box[v], false});
+            box[v] = Interval(box[v].inf(), box[v].mid());
+            continue;
+        }
+        if (read(pos, 1))
+            callback(read(pos, typeBits_), box);
+        while (!path.empty() && path.back().second) {
+            box[path.back().var] = path.back().x;
+            path.pop_back();
+        }
+        if (!path.empty()) {
+            Split &split = path.back();
+            split.second = true;
+            box[split.var] = Interval(split.x.mid(), split.x.sup());
+        }
+    } while (!path.empty());
+}
+
+// Bits are written from the least significant one
+
+void CompressedPaving::write(const uint64_t value, const nat width) {
+    for (nat b = 0; b < width; ++b, ++nbits_) {
+        if (nbits_ % 64 == 0)
+            bits_.push_back(0);
+        if ((value >> b) & 1)
+            bits_.back() |= (uint64_t) 1 << (nbits_ % 64);
+    }
+}
+
+uint64_t CompressedPaving::read(uint64_t &pos, const nat width) const {
+    uint64_t value = 0;
+    for (nat b = 0; b < width; ++b, ++pos)
+        value |= ((bits_[pos / 64] >> (pos % 64)) & 1) << b;
+    return value;
+}
+
+size_t CompressedPaving::bytes() const {
+    size_t bytes = bits_.size() * sizeof (uint64_t);
+    for (nat i = 0; i < others_.size(); ++i)
+        bytes += others_[i].size() * 2 * sizeof (double) * nvars();
+    return bytes + roots_.size() * 2 * sizeof (double) * nvars();
+}
+
+void CompressedPaving::for_each(const Callback &callback) const {
+    if (nbits_ > 0) {
+        uint64_t pos = 0;
+        Box box = varbox_.box();
+        decode(pos, box, callback);
+    }
+    for (nat i = 0; i < others_.size(); ++i) {
+        for (nat k = 0; k < others_[i].size(); ++k)
+            callback(i, others_[i][k]);
+    }
+}
+
+Paving CompressedPaving::paving() const {
+    Paving paving;
+    paving.set_ntypes(ntypes());
+    for_each([&paving](const nat i, const Box &box) {
+        paving.push_box(i, box);
+    });
+    for (nat k = 0; k < roots_.size(); ++k)
+        paving.push_root(roots_[k]);
+    paving.set_varbox(varbox_);
+    paving.set_type(type_);
+    return paving;
+}
+
+void CompressedPaving::save(const std::string filename) const {
+    std::ofstream f(filename.c_str(), std::ofstream::out | std::ofstream::binary);
+    if (!f) {
+        std::ostringstream os;
+        os << "Kodiak (CompressedPaving): file \"" << filename << "\" cannot be opened";
+        throw Growl(os.str());
+    }
+    f.write(CompressedMagic, sizeof (CompressedMagic));
+    writeRaw(f, VERSION);
+    writeRaw(f, ByteOrderMark);
+    writeRaw(f, (uint32_t) nvars());
+    writeRaw(f, (uint32_t) ntypes());
+    writeRaw(f, (int32_t) type_);
+    writeRaw(f, (uint32_t) nodes_);
+    writeRaw(f, nbits_);
+    for (nat v = 0; v < nvars(); ++v) {
+        std::string name = varbox_.name(v);
+        writeRaw(f, (uint32_t) name.size());
+        f.write(name.data(), name.size());
+        writeRaw(f, (double) varbox_.val(v).inf());
+        writeRaw(f, (double) varbox_.val(v).sup());
+    }
+    f.write(reinterpret_cast<const char *> (bits_.data()), bits_.size() * sizeof (uint64_t));
+    for (nat i = 0; i < ntypes(); ++i)
+        writeBoxes(f, others_[i], nvars());
+    writeBoxes(f, roots_, nvars());
+    if (!f) {
+        std::ostringstream os;
+        os << "Kodiak (CompressedPaving): file \"" << filename << "\" cannot be written";
+        throw Growl(os.str());
+    }
+}
+
+void CompressedPaving::load(const std::string filename) {
+    std::ifstream f(filename.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!f)
+        corrupted(filename, "cannot be opened");
+    char magic[4] = {0};
+    uint32_t version = 0, bom = 0, nvars = 0, ntypes = 0, nodes = 0;
+    int32_t type = -1;
+    f.read(magic, sizeof (magic));
+    readRaw(f, version);
+    readRaw(f, bom);
+    if (!f || std::memcmp(magic, CompressedMagic, 4) != 0)
+        corrupted(filename, "is not a compressed paving");
+    if (bom != ByteOrderMark)
+        corrupted(filename, "was written with a different byte order");
+    if (version != VERSION)
+        corrupted(filename, "has an unsupported version");
+    readRaw(f, nvars);
+    readRaw(f, ntypes);
+    readRaw(f, type);
+    readRaw(f, nodes);
+    CompressedPaving paving;
+    readRaw(f, paving.nbits_);
+    std::streampos start = f.tellg();
+    f.seekg(0, std::ifstream::end);
+    uint64_t length = f.tellg() - start;
+    f.seekg(start);
+    for (nat v = 0; f && v < nvars; ++v) {
+        uint32_t len = 0;
+        readRaw(f, len);
+        std::string name(len, ' ');
+        f.read(&name[0], len);
+        double lb = 0, ub = 0;
+        readRaw(f, lb);
+        readRaw(f, ub);
+        paving.varbox_.push(name, Interval(lb, ub));
+    }
+    if (!f)
+        corrupted(filename, "is truncated");
+    paving.type_ = type;
+    paving.nodes_ = nodes;
+    paving.varBits_ = bitsFor(nvars);
+    paving.typeBits_ = bitsFor(ntypes);
+    if (!f || (paving.nbits_ + 63) / 64 > length / sizeof (uint64_t))
+        corrupted(filename, "is truncated");
+    paving.bits_.resize((paving.nbits_ + 63) / 64);
+    f.read(reinterpret_cast<char *> (paving.bits_.data()), paving.bits_.size() * sizeof (uint64_t));
+    paving.others_.resize(ntypes);
+    for (nat i = 0; i < ntypes; ++i)
+        readBoxes(f, paving.others_[i], nvars);
+    readBoxes(f, paving.roots_, nvars);
+    paving.sizes_.assign(ntypes, 0);
+    uint64_t pos = 0;
+    if (!f || (paving.nbits_ > 0 && (!paving.valid(pos) || pos != paving.nbits_)))
+        corrupted(filename, "is truncated");
+    // Leaves are counted while the tree is decoded
+    paving.for_each([&paving](const nat i, const Box &) {
+        ++paving.sizes_[i];
+    });
+    *this = paving;
+}
@@ -0,0 +1,113 @@
+#ifndef KODIAK_COMPRESSED_PAVING_HPP
+#define KODIAK_COMPRESSED_PAVING_HPP
+
+#include <functional>
+
+#include "Paver.hpp"
+
+namespace kodiak {
+
+    /* CompressedPaving
+     *
+     * Paving stored as the tree of bisections of its initial box (see Paving::varbox), instead
+     * of as bounds of boxes. A node of the tree is either split at the midpoint of a variable,
+     * a leaf of some type, or empty. Nodes are written in preorder as a stream of bits: 1 and
+     * the variable for a split, 01 and the type for a leaf, and 00 for an empty node. Sibling
+     * leaves of the same type are collapsed into their parent. A box of the paving is placed
+     * in the tree by splitting first the variable of smallest index where it differs from the
+     * node, so the tree doesn't have to be the one of the search. Boxes that are not obtained
+     * by bisection of the initial box (e.g., contracted boxes), or that overlap boxes already
+     * in the tree, are kept as they are.
+     * Boxes are decoded on demand.
+     */
+
+    class CompressedPaving {
+    public:
+        static const uint32_t VERSION = 1;
+
+        typedef std::function<void (const nat, const Box &) > Callback;
+
+        CompressedPaving() : type_(-1), nbits_(0), nodes_(0), varBits_(0), typeBits_(0) {
+        }
+
+        CompressedPaving(const Paving &);
+
+        nat nvars() const {
+            return varbox_.size();
+        }
+
+        nat ntypes() const {
+            return sizes_.size();
+        }
+
+        int type() const {
+            return type_;
+        }
+
+        const NamedBox &varbox() const {
+            return varbox_;
+        }
+
+        // Number of leaves of type i, including the boxes kept as they are
+        nat size(const nat i) const {
+            return i < sizes_.size() ? sizes_[i] : 0;
+        }
+
+        // Number of nodes of the tree
+        nat nodes() const {
+            return nodes_;
+        }
+
+        // Boxes of type i that are not obtained by bisection of the initial box, or that overlap
+        // other boxes
+        const Boxes &others(const nat i) const {
+            return others_[i];
+        }
+
+        const Boxes &roots() const {
+            return roots_;
+        }
+
+        // Memory used by the tree and the boxes kept as they are, in bytes
+        size_t bytes() const;
+
+        // Calls a function on each box, with its type
+        void for_each(const Callback &) const;
+
+        // Paving with the decoded boxes
+        Paving paving() const;
+
+        void save(const std::string) const;
+        void load(const std::string);
+
+    private:
+        struct Node {
+            int var; // Split variable, -1 for a leaf or an empty node
+            int type; // Type of a leaf, -1 for an empty node
+            nat child; // First child of a split (the second one is child + 1)
+        };
+
+        bool bisection(const Box &) const;
+        bool overlaps(const std::vector<Node> &, const Box &) const;
+        void insert(std::vector<Node> &, const Box &, const nat);
+        void collapse(std::vector<Node> &, const nat);
+        void encode(const std::vector<Node> &, const nat);
+        bool valid(uint64_t &) const;
+        void decode(uint64_t &, Box &, const Callback &) const;
+        void write(const uint64_t, const nat);
+        uint64_t read(uint64_t &, const nat) const;
+
+        int type_;
+        NamedBox varbox_;
+        std::vector<nat> sizes_;
+        std::vector<uint64_t> bits_; // Nodes of the tree in preorder
+        uint64_t nbits_;
+        nat nodes_;
+        nat varBits_; // Bits of a variable
+        nat typeBits_; // Bits of a type
+        std::vector<Boxes> others_; // See others
+        Boxes roots_; // See Paving::roots
+    };
+}
+
+#endif // KODIAK_COMPRESSED_PAVING_HPP
@@ -19,7 +19,10 @@ namespace kodiak {
     struct Environment {
         Environment() : bbox(EmptyBBox), box(EmptyBox), namedBox(EmptyNamedBox) {}
         Environment(const BBox &bbox, const Box &box, const NamedBox &namedBox) : bbox(bbox), box(box), namedBox(namedBox) {}
-        Environment(const Environment &env) : bbox(env.bbox), box(env.box), namedBox(env.namedBox) {}
+        Environment(const Environment &) = default;
+        Environment(Environment &&) = default;
+        Environment &operator=(const Environment &) = default;
+        Environment &operator=(Environment &&) = default;
         BBox bbox;
         Box box;
         NamedBox namedBox;
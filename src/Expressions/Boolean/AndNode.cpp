@@ -32,6 +32,10 @@ Certainty AndNode::doEvaluate(const Environment &environment, const bool useBern
     }
 }
 
+bool AndNode::doContract(Environment &environment, const bool useBernstein) const {
+    return this->lhs->contract(environment, useBernstein) && this->rhs->contract(environment, useBernstein);
+}
+
 void AndNode::doPrint(std::ostream &cout) const {
     this->lhs->print(cout);
     cout << " && ";
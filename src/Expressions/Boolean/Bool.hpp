@@ -39,6 +39,10 @@ namespace kodiak {
                 return this->node_->eval(env, bernsteinEnclosure, eps);
             }
 
+            bool contract(Environment &env, const bool bernsteinEnclosure) const {
+                return this->node_->contract(env, bernsteinEnclosure);
+            }
+
             void print(std::ostream &os) const {
                 this->node_->print(os);
             }
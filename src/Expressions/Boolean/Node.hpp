@@ -33,6 +33,12 @@ namespace kodiak {
                 return doIsNaB();
             }
 
+            // Narrows the box of the environment to a sub-box that contains all the points
+            // where the expression may be true. Returns false if there are none.
+            bool contract(Environment &env, const bool useBernstein) const {
+                return this->doContract(env, useBernstein);
+            }
+
         private:
             virtual Certainty doEvaluate(const Environment &, const bool, const real) const = 0;
 
@@ -45,6 +51,10 @@ namespace kodiak {
             virtual bool doIsNaB() const {
                 return false;
             }
+
+            virtual bool doContract(Environment &, const bool) const {
+                return true;
+            }
         };
 
         std::ostream& operator<<(std::ostream &os, const Node &node);
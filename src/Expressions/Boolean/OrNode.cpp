@@ -31,6 +31,24 @@ Certainty OrNode::doEvaluate(const Environment &environment, const bool useBerns
     }
 }
 
+bool OrNode::doContract(Environment &environment, const bool useBernstein) const {
+    Environment left{environment};
+    Environment right{environment};
+    bool isLeftPossible = this->lhs->contract(left, useBernstein);
+    bool isRightPossible = this->rhs->contract(right, useBernstein);
+    if (!isLeftPossible && !isRightPossible)
+        return false;
+    if (!isRightPossible)
+        environment.box = left.box;
+    else if (!isLeftPossible)
+        environment.box = right.box;
+    else {
+        for (nat v = 0; v < environment.size(); ++v)
+            environment.box[v] = left.box[v].hull(right.box[v]);
+    }
+    return true;
+}
+
 void OrNode::doPrint(std::ostream &cout) const {
     this->lhs->print(cout);
     cout << " || ";
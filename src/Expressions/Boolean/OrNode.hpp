@@ -18,6 +18,8 @@ namespace kodiak {
         private:
             virtual Certainty doEvaluate(const Environment &, const bool, const real) const override;
 
+            virtual bool doContract(Environment &, const bool) const override;
+
             virtual void doPrint(std::ostream & = std::cout) const override;
 
             virtual bool equals(const Node &) const override;
@@ -3,9 +3,17 @@
 namespace kodiak {
     namespace BooleanExpressions {
 
+        namespace {
+            // Relational expressions leave the boxes they evaluate as they find them, but they
+            // take them by reference. The environment is copied into these boxes, which keep
+            // their memory from one evaluation to the next.
+            thread_local Box anotherBox;
+            thread_local NamedBox anotherNamedBox;
+        }
+
         Certainty RelationNode::doEvaluate(const Environment &env, const bool i, const real eps) const {
-            Box anotherBox{env.box};
-            NamedBox anotherNamedBox{env.namedBox};
+            anotherBox = env.box;
+            anotherNamedBox = env.namedBox;
             int result = this->delegate_->eval(anotherBox, anotherNamedBox, i, eps);
             switch (result) {
                 case -2:
@@ -19,6 +27,11 @@ namespace kodiak {
             }
         }
 
+        bool RelationNode::doContract(Environment &env, const bool i) const {
+            anotherNamedBox = env.namedBox;
+            return this->delegate_->contract(env.box, anotherNamedBox, i);
+        }
+
         void RelationNode::doPrint(std::ostream &ostream) const {
             this->delegate_->print(ostream);
         }
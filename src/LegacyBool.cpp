@@ -3,13 +3,29 @@
 using namespace kodiak;
 
 RelExpr::RelExpr(const kodiak::Real &r, const kodiak::RelType rel, const bool poly, const Substitution &sigma,
-                 const nat nvars) :
-op_(rel) {
+                 const nat nvars, const bool ad) :
+op_(rel), automaticDifferentiation_(ad), poly_(poly), nvars_(std::max(nvars, r.numberOfVariables())) {
     ope_ = poly ? polynomial(r) : r;
-    partialDerivativesPerVariable_.resize(std::max(nvars, r.numberOfVariables()));
-    for (nat v = 0; v < partialDerivativesPerVariable_.size(); ++v) {
-        partialDerivativesPerVariable_[v] = (poly ? polynomial(r.deriv(v)) : r.deriv(v)).subs(sigma);
+    if (ad) {
+        expr_ = r;
+        sigma_ = sigma;
+    } else {
+        partialDerivativesPerVariable_.resize(nvars_);
+        for (nat v = 0; v < partialDerivativesPerVariable_.size(); ++v) {
+            partialDerivativesPerVariable_[v] = (poly ? polynomial(r.deriv(v)) : r.deriv(v)).subs(sigma);
+        }
     }
+    compile();
+}
+
+void RelExpr::compile() {
+    compiledOpe_.compile(ope_);
+    contractor_ = CompiledExpr();
+    if (automaticDifferentiation_)
+        compiledOpe_.differentiate(ope_.numberOfVariables(), sigma_);
+    compiledPartialDerivatives_.resize(partialDerivativesPerVariable_.size());
+    for (nat v = 0; v < partialDerivativesPerVariable_.size(); ++v)
+        compiledPartialDerivatives_[v].compile(partialDerivativesPerVariable_[v]);
 }
 
 /*
@@ -25,77 +41,136 @@ op_(rel) {
  * instance variable
  */
 int RelExpr::eval(Box &box, NamedBox &constbox, const bool enclosure, const real eps) {
-    Interval i = ope_.eval(box, constbox, enclosure);
+    Interval i = compiledOpe_.eval(box, constbox, enclosure);
     int cly = i.rel0(op_, eps);
     if (cly >= 0) return cly;
+    Box gradient; // Computed on demand when partial derivatives are automatically differentiated
     for (nat var = 0; var < ope_.numberOfVariables(); var++) {
-        Interval initialVarEnclosure = box[var];
-        try {
-            Interval derivative = derivativeForVariable(var).eval(box, constbox, enclosure);
-            bool isIncreasing = derivative.cge(0);
-            bool isDecreasing = derivative.cle(0);
-            if ((isIncreasing && (op_ == LE || op_ == LT))
-                    || (isDecreasing && (op_ == GE || op_ == GT))) {
-                box[var] = initialVarEnclosure.supremum();
-                Interval sup = ope_.eval(box, constbox);
-                int dly = sup.rel0(op_);
-                if (dly > 0) {
-                    box[var] = initialVarEnclosure;
-                    return dly;
-                }
-                box[var] = initialVarEnclosure.infimum();
-                Interval inf = ope_.eval(box, constbox);
-                dly = inf.rel0(op_);
-                if (dly == 0) {
-                    box[var] = initialVarEnclosure;
-                    return dly;
-                }
-            } else if ((isIncreasing && (op_ == GE || op_ == GT)) ||
-                    (isDecreasing && (op_ == LE || op_ == LT))) {
-                box[var] = initialVarEnclosure.infimum();
-                Interval inf = ope_.eval(box, constbox);
-                int dly = inf.rel0(op_);
-                if (dly > 0) {
-                    box[var] = initialVarEnclosure;
-                    return dly;
-                }
-                box[var] = initialVarEnclosure.supremum();
-                Interval sup = ope_.eval(box, constbox);
-                dly = sup.rel0(op_);
-                if (dly == 0) {
-                    box[var] = initialVarEnclosure;
-                    return dly;
-                }
-            } else   if ((isIncreasing || isDecreasing) && op_ == EQ) {
-                box[var] = initialVarEnclosure.infimum();
-                Interval inf = ope_.eval(box, constbox);
-                if ((isIncreasing && inf.cgt(0)) || (isDecreasing && inf.clt(0))) {
-                    box[var] = initialVarEnclosure;
-                    return 0;
-                }
-                box[var] = initialVarEnclosure.supremum();
-                Interval sup = ope_.eval(box, constbox);
-                if ((isIncreasing && sup.clt(0)) || (isDecreasing && sup.cgt(0))) {
-                    box[var] = initialVarEnclosure;
-                    return 0;
-                }
+        Interval derivative;
+        if (automaticDifferentiation_) {
+            if (gradient.empty()) {
+                Interval value;
+                gradient.assign(ope_.numberOfVariables(), Interval::ENTIRE());
+                if (!compiledOpe_.tryEval(value, box, constbox, gradient, enclosure))
+                    report(compiledOpe_);
             }
-        } catch (Growl const & growl) {
-            if (Kodiak::debug()) {
-                std::cout << "[GrowlException@RelExpr::eval]" << growl.what() << std::endl;
+            derivative = gradient[var];
+        } else if (var < compiledPartialDerivatives_.size()) {
+            if (!compiledPartialDerivatives_[var].tryEval(derivative, box, constbox, enclosure)) {
+                report(compiledPartialDerivatives_[var]);
+                continue;
             }
-        }
+        } else
+            derivative = Interval(0);
+        Interval initialVarEnclosure = box[var];
+        int dly = monotonicity(box, constbox, var, derivative);
         box[var] = initialVarEnclosure;
+        if (dly >= 0)
+            return dly;
     }
     return cly;
 }
 
+/*
+ * RelExpr::monotonicity
+ *
+ * When the expression is monotone in var, decides the relation from the values at the
+ * endpoints of box[var]. Returns the certainty of the relation, or -1 if it cannot be decided
+ * or the expression is undefined at an endpoint. box[var] is left at one of the endpoints.
+ */
+int RelExpr::monotonicity(Box &box, NamedBox &constbox, const nat var, const Interval &derivative) {
+    Interval initialVarEnclosure = box[var];
+    bool isIncreasing = derivative.cge(0);
+    bool isDecreasing = derivative.cle(0);
+    Interval inf;
+    Interval sup;
+    if ((isIncreasing && (op_ == LE || op_ == LT))
+            || (isDecreasing && (op_ == GE || op_ == GT))) {
+        box[var] = initialVarEnclosure.supremum();
+        if (!compiledOpe_.tryEval(sup, box, constbox))
+            return report(compiledOpe_);
+        if (sup.rel0(op_) > 0)
+            return sup.rel0(op_);
+        box[var] = initialVarEnclosure.infimum();
+        if (!compiledOpe_.tryEval(inf, box, constbox))
+            return report(compiledOpe_);
+        if (inf.rel0(op_) == 0)
+            return 0;
+    } else if ((isIncreasing && (op_ == GE || op_ == GT)) ||
+            (isDecreasing && (op_ == LE || op_ == LT))) {
+        box[var] = initialVarEnclosure.infimum();
+        if (!compiledOpe_.tryEval(inf, box, constbox))
+            return report(compiledOpe_);
+        if (inf.rel0(op_) > 0)
+            return inf.rel0(op_);
+        box[var] = initialVarEnclosure.supremum();
+        if (!compiledOpe_.tryEval(sup, box, constbox))
+            return report(compiledOpe_);
+        if (sup.rel0(op_) == 0)
+            return 0;
+    } else if ((isIncreasing || isDecreasing) && op_ == EQ) {
+        box[var] = initialVarEnclosure.infimum();
+        if (!compiledOpe_.tryEval(inf, box, constbox))
+            return report(compiledOpe_);
+        if ((isIncreasing && inf.cgt(0)) || (isDecreasing && inf.clt(0)))
+            return 0;
+        box[var] = initialVarEnclosure.supremum();
+        if (!compiledOpe_.tryEval(sup, box, constbox))
+            return report(compiledOpe_);
+        if ((isIncreasing && sup.clt(0)) || (isDecreasing && sup.cgt(0)))
+            return 0;
+    }
+    return -1;
+}
+
+// Domain errors only mean that no information is gained from monotonicity
+
+int RelExpr::report(const CompiledExpr &expr) {
+    if (Kodiak::debug()) {
+        std::cout << "[DomainError@RelExpr::eval]" << expr.error() << std::endl;
+    }
+    return -1;
+}
+
+bool RelExpr::contract(Box &box, NamedBox &constbox, const bool enclosure) {
+    const real infinity = std::numeric_limits<real>::infinity();
+    Interval target = op_ == EQ ? Interval(0) : op_ == LE || op_ == LT ? Interval(-infinity, 0) : Interval(0, infinity);
+    if (contractor_.empty())
+        contractor_.compile(ope_, true);
+    return contractor_.contract(box, constbox, target, enclosure);
+}
+
+void RelExpr::gradient(const Box &box, NamedBox &constbox, Box &gradient, const nat n, const bool enclosure) {
+    if (automaticDifferentiation_) {
+        compiledOpe_.eval(box, constbox, gradient, enclosure);
+        gradient.resize(n, Interval(0));
+        return;
+    }
+    gradient.assign(n, Interval(0));
+    for (nat v = 0; v < n && v < compiledPartialDerivatives_.size(); ++v)
+        gradient[v] = compiledPartialDerivatives_[v].eval(box, constbox, enclosure);
+}
+
 Real RelExpr::derivativeForVariable(const nat v) const {
+    if (automaticDifferentiation_ && v < nvars_)
+        return (poly_ ? polynomial(expr_.deriv(v)) : expr_.deriv(v)).subs(sigma_);
     if (v < partialDerivativesPerVariable_.size())
         return partialDerivativesPerVariable_[v];
     return val(0);
 }
 
+void RelExpr::pushEnclosures() {
+    compiledOpe_.pushEnclosures();
+    for (nat v = 0; v < compiledPartialDerivatives_.size(); ++v)
+        compiledPartialDerivatives_[v].pushEnclosures();
+}
+
+void RelExpr::popEnclosures() {
+    compiledOpe_.popEnclosures();
+    for (nat v = 0; v < compiledPartialDerivatives_.size(); ++v)
+        compiledPartialDerivatives_[v].popEnclosures();
+}
+
 void RelExpr::print(std::ostream &os) const {
     os << ope_ << " " << op_ << " 0";
 }
@@ -1,14 +1,16 @@
 #ifndef KODIAK_LEGACYBOOL_HPP
 #define KODIAK_LEGACYBOOL_HPP
 
-#include "Real.hpp"
+#include "CompiledExpr.hpp"
 
 namespace kodiak {
 
     class RelExpr {
     public:
+        // If ad is true, partial derivatives are computed by forward-mode automatic differentiation
+        // at evaluation time rather than built as symbolic expressions
         RelExpr(const Real &, const RelType, const bool = false,
-                const Substitution & = EmptySubstitution, const nat nvars = 0);
+                const Substitution & = EmptySubstitution, const nat nvars = 0, const bool ad = false);
 
         Real ope() const {
             return ope_;
@@ -25,14 +27,44 @@ namespace kodiak {
 
         int eval(Box &, NamedBox &, const bool = false, const real = 0);
 
+        // Narrows box to a sub-box that contains all the points of box that satisfy the relation.
+        // Returns false if there is no such point.
+        bool contract(Box &, NamedBox &, const bool = false);
+
+        // Enclosure of the expression
+        Interval value(const Box &box, NamedBox &constbox, const bool enclosure = false) {
+            return compiledOpe_.eval(box, constbox, enclosure);
+        }
+
+        // Sets gradient to the enclosures of the partial derivatives of the expression with respect
+        // to the first n variables
+        void gradient(const Box &, NamedBox &, Box &gradient, const nat n, const bool = false);
+
         Real derivativeForVariable(const nat) const;
 
+        // Enclosure cache of the evaluation tapes along the path of a search (see CompiledExpr)
+        void pushEnclosures();
+        void popEnclosures();
+
         void print(std::ostream &) const;
 
     private:
+        void compile();
+        int monotonicity(Box &, NamedBox &, const nat, const Interval &);
+        static int report(const CompiledExpr &);
+
         Real ope_;
         RelType op_;
         Realn partialDerivativesPerVariable_;
+        bool automaticDifferentiation_;
+        // Only used by derivativeForVariable when automaticDifferentiation_ is set
+        Real expr_; // Expression before its translation into a polynomial
+        bool poly_;
+        Substitution sigma_;
+        nat nvars_; // Number of partial derivatives
+        CompiledExpr compiledOpe_; // Evaluation tape of ope_
+        std::vector<CompiledExpr> compiledPartialDerivatives_; // Evaluation tapes of partialDerivativesPerVariable_
+        CompiledExpr contractor_; // Tape of ope_ with expanded polynomials, compiled by the first contract
     };
 
     std::ostream &operator<<(std::ostream &, const kodiak::RelExpr &);
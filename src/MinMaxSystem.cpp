@@ -7,11 +7,12 @@ MinMaxSystem::MinMaxSystem(const std::string id) {
     varselect_ = 1;
     granularityAkaDefaultResolutionForVariablesAsPercentageOfInitialBox_ = 0;
     absoluteToleranceForStoppingBranchAndBound_ = 0.01;
+    relativeGap_ = 0;
 }
 
 bool MinMaxSystem::isSound(const MinMax &minmax, const Certainties &, const Environment &box) {
-    Box b = box.box;
-    int cert = evalSystem(b);
+    temp_ = box.box;
+    int cert = evalSystem(temp_);
     return cert == 0 || (!minmax.empty() && minmax.isSound() &&
             (cert <= 0 ||
             ((minmax.min_or_max() > MINMAX || !minmax.min_point().empty()) &&
@@ -24,11 +25,15 @@ void MinMaxSystem::minmax(const Real &e, const MinMaxType min_or_max) {
     temp_.resize(variablesEnclosures_.size());
     expr_ = e.index(variablesEnclosures_, constantsEnclosures_);
     expr_.checkIndexed(globalDefinitions_);
-    dexpr_.resize(variablesEnclosures_.size());
-    for (nat v = 0; v < variablesEnclosures_.size(); ++v)
-        dexpr_[v] = (defaultEnclosureMethodTrueBernsteinFalseInterval_ ? polynomial(expr_.deriv(v)) : expr_.deriv(v)).subs(defdx_);
+    dexpr_.clear();
+    if (!automaticDifferentiation_) {
+        dexpr_.resize(variablesEnclosures_.size());
+        for (nat v = 0; v < variablesEnclosures_.size(); ++v)
+            dexpr_[v] = (defaultEnclosureMethodTrueBernsteinFalseInterval_ ? polynomial(expr_.deriv(v)) : expr_.deriv(v)).subs(defdx_);
+    }
     if (defaultEnclosureMethodTrueBernsteinFalseInterval_)
         expr_ = polynomial(expr_);
+    compile();
     minmax_.init(min_or_max_.back());
     Certainties certs;
     certs.init(numberOfRelationalFormulas());
@@ -87,7 +92,7 @@ void MinMaxSystem::evaluate(MinMax &answer, Certainties &certs, Environment &box
     } else
         mid_cert = evalSystem(temp_);
     if (mid_cert > 0) { // Midpoint satisfies constraints
-        Interval Mid = expr_.eval(temp_, globalDefinitionsEnclosures_);
+        Interval Mid = compiledExpr_.eval(temp_, globalDefinitionsEnclosures_);
         answer.min_point_ = mid_point; //.assign(mid_point.begin(),mid_point.end());
         answer.max_point_ = mid_point; //.assign(mid_point.begin(),mid_point.end());
         answer.ub_of_min_ = Mid.sup();
@@ -99,13 +104,14 @@ void MinMaxSystem::evaluate(MinMax &answer, Certainties &certs, Environment &box
     real var_max_point = 0;
     real max_diff = 0;
     Interval d_it;
-    for (VarBag::iterator it = expr_.vars().begin(); it != expr_.vars().end(); ++it) {
-        nat v = it->first;
+    Box gradient; // Computed on demand when partial derivatives are automatically differentiated
+    for (nat k = 0; k < exprVariables_.size(); ++k) {
+        nat v = exprVariables_[k];
         if (!box[v].isPoint() && box[v].diam() > variableResolutionsAkaSmallestRangeConsideredForEachVariable_[v]) {
             Interval save_it = temp_[v];
             temp_[v] = box[v].infimum();
             int inf_cert = evalSystem(temp_);
-            Interval lb_it = expr_.eval(temp_, globalDefinitionsEnclosures_);
+            Interval lb_it = compiledExpr_.eval(temp_, globalDefinitionsEnclosures_);
             if (inf_cert > 0) { // Infpoint satisfies constraints
                 if (answer.min_point_.empty() || lb_it.sup() < answer.ub_of_min_) {
                     answer.ub_of_min_ = lb_it.sup();
@@ -124,7 +130,7 @@ void MinMaxSystem::evaluate(MinMax &answer, Certainties &certs, Environment &box
             }
             temp_[v] = box[v].supremum();
             int sup_cert = evalSystem(temp_);
-            Interval ub_it = expr_.eval(temp_, globalDefinitionsEnclosures_);
+            Interval ub_it = compiledExpr_.eval(temp_, globalDefinitionsEnclosures_);
             if (sup_cert > 0) { // Suppoint satisfies constraints
                 if (answer.min_point_.empty() || ub_it.sup() < answer.ub_of_min_) {
                     answer.ub_of_min_ = ub_it.sup();
@@ -142,46 +148,55 @@ void MinMaxSystem::evaluate(MinMax &answer, Certainties &certs, Environment &box
                 }
             }
             if (cert > 0) {
-                try {
-                    d_it = dexpr_[v].eval(box.box, defbox, defaultEnclosureMethodTrueBernsteinFalseInterval_);
-                    bool ge = d_it.cge(0);
-                    bool le = d_it.cle(0);
-                    if (ge || le) {
-                        dirvar_.dir = true;
-                        if ((ge && min_or_max_.back() > 0) ||
-                                (le && min_or_max_.back() < 0))
-                            dirvar_.dir = false;
-                        // dir represents the lower (false) or upper (right) bound. 
-                        if (!d_it.contains(0)) {
-                            Where w = where(dirvars(), v);
-                            if (w == INTERIOR ||
-                                    (min_or_max_.back() != 0 && w == LEFT_INTERIOR && dirvar_.dir) ||
-                                    (min_or_max_.back() != 0 && w == RIGHT_INTERIOR && !dirvar_.dir)) {
-                                // The solution is necessarily found outside this box
-                                if (ge) {
-                                    answer.mm_ = Interval(lb_it.inf(),ub_it.sup());
-                                    answer.lb_of_max_ = ub_it.inf();
-                                    answer.ub_of_min_ = lb_it.sup();
-                                } else {
-                                    answer.mm_ = Interval(ub_it.inf(),lb_it.sup());
-                                    answer.lb_of_max_ = lb_it.inf();
-                                    answer.ub_of_min_ = ub_it.sup();
-                                }
-                                return;
+                // A domain error leaves the derivative unknown
+                if (automaticDifferentiation_) {
+                    if (gradient.empty()) {
+                        Interval value;
+                        gradient.assign(box.size(), Interval::ENTIRE());
+                        if (!compiledExpr_.tryEval(value, box.box, defbox, gradient,
+                                defaultEnclosureMethodTrueBernsteinFalseInterval_) && Kodiak::debug())
+                            std::cout << "[DomainError@MinMaxSystem::evaluate]" << compiledExpr_.error() << std::endl;
+                    }
+                    d_it = gradient[v];
+                } else if (!compiledDexpr_[v].tryEval(d_it, box.box, defbox,
+                        defaultEnclosureMethodTrueBernsteinFalseInterval_)) {
+                    if (Kodiak::debug())
+                        std::cout << "[DomainError@MinMaxSystem::evaluate]" << compiledDexpr_[v].error() << std::endl;
+                    d_it = Interval::ENTIRE();
+                }
+                bool ge = d_it.cge(0);
+                bool le = d_it.cle(0);
+                if (ge || le) {
+                    dirvar_.dir = true;
+                    if ((ge && min_or_max_.back() > 0) ||
+                            (le && min_or_max_.back() < 0))
+                        dirvar_.dir = false;
+                    // dir represents the lower (false) or upper (right) bound. 
+                    if (!d_it.contains(0)) {
+                        Where w = where(dirvars(), v);
+                        if (w == INTERIOR ||
+                                (min_or_max_.back() != 0 && w == LEFT_INTERIOR && dirvar_.dir) ||
+                                (min_or_max_.back() != 0 && w == RIGHT_INTERIOR && !dirvar_.dir)) {
+                            // The solution is necessarily found outside this box
+                            if (ge) {
+                                answer.mm_ = Interval(lb_it.inf(),ub_it.sup());
+                                answer.lb_of_max_ = ub_it.inf();
+                                answer.ub_of_min_ = lb_it.sup();
+                            } else {
+                                answer.mm_ = Interval(ub_it.inf(),lb_it.sup());
+                                answer.lb_of_max_ = lb_it.inf();
+                                answer.ub_of_min_ = ub_it.sup();
                             }
+                            return;
                         }
-                        dirvar_.var = v;
-                        dirvar_.splitting = 1;
-                        if (min_or_max_.back() != 0)
-                            dirvar_.onlyone = true; // Only compute one side
-                        else if (le)
-                            dirvar_.dir = false; // Begin with the min
-                        break;
-                    }
-                } catch (Growl const & growl) {
-                    if (Kodiak::debug()) {
-                        std::cout << "[GrowlException@MinMaxSystem::evaluate]" << growl.what() << std::endl;
                     }
+                    dirvar_.var = v;
+                    dirvar_.splitting = 1;
+                    if (min_or_max_.back() != 0)
+                        dirvar_.onlyone = true; // Only compute one side
+                    else if (le)
+                        dirvar_.dir = false; // Begin with the min
+                    break;
                 }
             }
             if (varselect_ > 0) {
@@ -189,7 +204,7 @@ void MinMaxSystem::evaluate(MinMax &answer, Certainties &certs, Environment &box
                 evalGlobalDefinitions(temp_);
                 if (cert > 0 || varselect_ == 1)
                     // Narkawitz/Munoz's strategy for variable selection
-                    d_it = expr_.eval(temp_, globalDefinitionsEnclosures_);
+                    d_it = compiledExpr_.eval(temp_, globalDefinitionsEnclosures_);
                 else
                     sosSystem(d_it, certs, temp_, v);
                 real max_diff_it = d_it.diam();
@@ -202,7 +217,7 @@ void MinMaxSystem::evaluate(MinMax &answer, Certainties &certs, Environment &box
             temp_[v] = save_it;
         }
     }
-    answer.mm_ = expr_.eval(box.box, defbox, defaultEnclosureMethodTrueBernsteinFalseInterval_);
+    answer.mm_ = compiledExpr_.eval(box.box, defbox, defaultEnclosureMethodTrueBernsteinFalseInterval_);
     if (var_min < box.size()) {
         answer.min_point_[var_min] = var_min_point;
     }
@@ -319,6 +334,29 @@ bool MinMaxSystem::local_exit(const MinMax &answer) {
     return (isMinimizing || upperClosurePrecissionReached);
 }
 
+// Contraction removes points that don't satisfy the constraints, so the enclosure of the
+// expression is narrowed to the contracted box
+
+bool MinMaxSystem::contract(MinMax &answer, Certainties &certs, Environment &box) {
+    if (certs.get() > 0)
+        return true;
+    Box &original = original_;
+    original = box.box;
+    if (!contractSystem(box.box)) {
+        answer = MinMax();
+        return false;
+    }
+    if (box.box == original)
+        return true;
+    Interval mm = compiledExpr_.eval(box.box, globalDefinitionsEnclosures_, defaultEnclosureMethodTrueBernsteinFalseInterval_);
+    answer.mm_ = Interval(std::max(mm.inf(), answer.mm_.inf()), std::min(mm.sup(), answer.mm_.sup()));
+    // The variable selected by evaluate may not be splittable anymore
+    if (dirvar_.var < box.size() && (box[dirvar_.var].isPoint() ||
+            box[dirvar_.var].diam() <= variableResolutionsAkaSmallestRangeConsideredForEachVariable_[dirvar_.var]))
+        dirvar_.init(box.size());
+    return true;
+}
+
 void MinMaxSystem::select(DirVar &dirvar, Certainties &certs, Environment &box) {
     if (varselect_ == 0)
         round_robin(dirvar, certs, box);
@@ -326,6 +364,71 @@ void MinMaxSystem::select(DirVar &dirvar, Certainties &certs, Environment &box)
         dirvar = dirvar_;
 }
 
+BranchAndBoundDF<Certainties, MinMax, Environment> *MinMaxSystem::clone() const {
+    if (typeid(*this) != typeid(MinMaxSystem))
+        return NULL;
+    return new MinMaxSystem(*this);
+}
+
+void MinMaxSystem::compile() {
+    exprVariables_ = VarSet(expr_.vars()).elements();
+    compiledExpr_.compile(expr_);
+    if (automaticDifferentiation_)
+        compiledExpr_.differentiate(variablesEnclosures_.size(), defdx_);
+    compiledDexpr_.resize(dexpr_.size());
+    for (nat v = 0; v < dexpr_.size(); ++v)
+        compiledDexpr_[v].compile(dexpr_[v]);
+}
+
+void MinMaxSystem::merge(const BranchAndBoundDF<Certainties, MinMax, Environment> &worker) {
+    accumulate(static_cast<const MinMaxSystem &>(worker).acc_);
+}
+
+// Best-first search explores first the boxes of lowest lower bound when computing the min,
+// of highest upper bound when computing the max, and of widest enclosure otherwise
+
+real MinMaxSystem::priority(const MinMax &answer, const Certainties &, const Environment &) {
+    if (answer.empty())
+        return 0;
+    if (min_or_max_.back() < 0)
+        return -answer.mm_.inf();
+    if (min_or_max_.back() > 0)
+        return answer.mm_.sup();
+    return answer.mm_.diam();
+}
+
+// Rebuilds the stack of min_or_max objectives from the selections of the current node.
+// A first lower and upper bound split pushes a min objective (if the objective is both),
+// which the second one replaces by a max objective (see split).
+
+void MinMaxSystem::resume() {
+    min_or_max_.resize(1);
+    for (nat k = 0; k < dirvars().size(); ++k) {
+        const DirVar &dirvar = dirvars()[k];
+        if (dirvar.splitting != 1)
+            continue;
+        if (!dirvar.first())
+            min_or_max_.push_back(1);
+        else if (min_or_max_.back() == 0)
+            min_or_max_.push_back(-1);
+    }
+}
+
+// The priority of the best open node is the best bound of the objective (see priority)
+
+bool MinMaxSystem::stop(const real priority) {
+    real gap, value;
+    if (min_or_max_.front() < 0 && !acc_.min_point_.empty()) {
+        value = acc_.ub_of_min_;
+        gap = value + priority;
+    } else if (min_or_max_.front() > 0 && !acc_.max_point_.empty()) {
+        value = acc_.lb_of_max_;
+        gap = priority - value;
+    } else
+        return false;
+    return gap <= absoluteToleranceForStoppingBranchAndBound_ || gap <= relativeGap_ * std::abs(value);
+}
+
 void MinMaxSystem::print(std::ostream &os) const {
     os << "** Inputs **" << std::endl;
     printSystem(os, debug());
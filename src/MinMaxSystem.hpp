@@ -1,6 +1,8 @@
 #ifndef KODIAK_MINMAXSYSTEM
 #define KODIAK_MINMAXSYSTEM
 
+#include <typeinfo>
+
 #include "BranchAndBoundDF.hpp"
 #include "Environment.hpp"
 #include "MinMax.hpp"
@@ -34,6 +36,17 @@ namespace kodiak {
         void print(std::ostream & = std::cout) const;
         void benchmark(std::ostream & = std::cout);
 
+        real relgap() const {
+            return relativeGap_;
+        }
+
+        // Best-first search (see set_frontier) of the min or the max stops when the gap between
+        // the best point found so far and the best bound of the boxes not explored yet is less
+        // than the tolerance, or than relgap times the value at that point
+        void set_relgap(const real relgap) {
+            relativeGap_ = relgap;
+        }
+
     protected:
         void split(const DirVar &, Environment &, const Interval &, const real);
         void evaluate(MinMax &, Certainties &, Environment &);
@@ -43,22 +56,50 @@ namespace kodiak {
         void accumulate(const MinMax &);
         bool prune(const MinMax &);
         bool local_exit(const MinMax &);
+
+        // Children of a node start their evaluation from the enclosures of the node
+        void descend() {
+            pushEnclosures();
+            compiledExpr_.pushEnclosures();
+        }
+
+        void ascend() {
+            popEnclosures();
+            compiledExpr_.popEnclosures();
+        }
+
+        bool contracting() const {
+            return contraction() && numberOfRelationalFormulas() > 0;
+        }
+
+        bool contract(MinMax &, Certainties &, Environment &);
         // set_varselect:
         // 0 : round robin
         // 1 : select variable of maximum sos-weight on the function to be min/max
         // 2 : select variable of maximum sos-weight on the system of constraints
         void select(DirVar &, Certainties &, Environment &);
         bool isSound(const MinMax &, const Certainties &, const Environment &);
+        BranchAndBoundDF<Certainties, MinMax, Environment> *clone() const;
+        void merge(const BranchAndBoundDF<Certainties, MinMax, Environment> &);
+        real priority(const MinMax &, const Certainties &, const Environment &);
+        void resume();
+        bool stop(const real);
+        void compile();
         Box temp_; // Temporary box for internal computations
+        Box original_; // Box of the node being contracted, reused from node to node
         DirVar dirvar_; // Selected DirVar object at each recursive step
         Real expr_; // Expression
+        Tuple exprVariables_; // Variables of expr_ in increasing order
         Realn dexpr_; // Partial derivatives of expression
+        CompiledExpr compiledExpr_; // Evaluation tape of expr_
+        std::vector<CompiledExpr> compiledDexpr_; // Evaluation tapes of dexpr_
         MinMax acc_; // Accumulated value for pruning
         // min_or_max_ = 0 : compute both min and max. This is the default value.
         // min_or_max_ < 0 : compute min
         // min_or_max_ > 0 : compute max
         Ints min_or_max_; // Stack of min_or_max objective
         MinMax minmax_; // MinMax computed by branch and bound algorithm
+        real relativeGap_; // Relative gap of the best-first search
     };
 
     Interval min(const Real &, const NamedBox &, const NamedBox &, const int = -1, const nat = 0);
@@ -73,8 +73,8 @@ namespace kodiak {
             real var_max_point = 0;
             real max_diff = 0;
             Interval d_it;
-            for (VarBag::iterator it = expr_.vars().begin(); it != expr_.vars().end(); ++it) {
-                nat v = it->first;
+            for (nat k = 0; k < exprVariables_.size(); ++k) {
+                nat v = exprVariables_[k];
                 if (!env[v].isPoint() &&
                     env[v].diam() > variableResolutionsAkaSmallestRangeConsideredForEachVariable_[v]) {
                     Interval save_it = temp_[v];
@@ -47,7 +47,7 @@ namespace kodiak {
         void evaluate(PrePaving &paving, Ints &certainties, Environment &box) override {
             currentBoxCertainty_ = 1;
             nat numberOfFormulas = 1;
-            Box aBox = box.box;
+            const Box &aBox = box.box;
             for (nat i = 0; i < numberOfFormulas; ++i) {
                 bool isCurrentFormulaTrue = certainties[i] > 0;
                 if (isCurrentFormulaTrue) continue;
@@ -66,7 +66,7 @@ namespace kodiak {
 //                        continue;
 //                    }
 //                }
-                evalGlobalDefinitions(); // TODO: Take out from the loop, since it should be constant or, if not, it would be asymmetric
+                evalGlobalDefinitions(); // Only global definitions whose variables changed are evaluated again
                 certainties[i] = CertaintyClass::certainty2Int(
                         this->booleanExpression_.eval(box, this->defaultEnclosureMethodTrueBernsteinFalseInterval_,
                                                        this->absoluteToleranceForStoppingBranchAndBound_));
@@ -91,6 +91,16 @@ namespace kodiak {
             round_robin(dirvar, certainties, box);
         }
 
+        bool contractFormulas(Environment &env) override {
+            return this->booleanExpression_.contract(env, this->defaultEnclosureMethodTrueBernsteinFalseInterval_);
+        }
+
+        BranchAndBoundDF<Ints, PrePaving, Environment> *clone() const override {
+            if (typeid(*this) != typeid(NewPaver))
+                return NULL;
+            return new NewPaver(*this);
+        }
+
     public:
         void setBooleanExpression(Bool const & expr) {
             // TODO: Index expression
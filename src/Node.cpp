@@ -1,5 +1,10 @@
 #include "Node.hpp"
 
+#include <memory>
+#include <list>
+#include <queue>
+#include <unordered_map>
+
 using namespace kodiak;
 
 std::string Node::toString() const {
@@ -75,7 +80,7 @@ void RealVar_Node::print(std::ostream &os) const {
 // --- RealName_Node ---
 
 RealName_Node::RealName_Node(const std::string name, const bool local) :
-name_(name), local_(local) {
+name_(name), slot_(0), local_(local) {
     if (local) {
         localVariables_.insert(name);
         realExpressionType_ = REAL;
@@ -83,7 +88,6 @@ name_(name), local_(local) {
         globalConstants_.insert(name);
         realExpressionType_ = ATOM;
     }
-    db_ = 0;
 }
 
 Real RealName_Node::deriv(const nat v) const {
@@ -95,8 +99,14 @@ Real RealName_Node::deriv(const nat v) const {
         return val(Interval::ZERO());
 }
 
+// Names are unique in a named box, so the index where the name was last found is tried first
+
 Interval RealName_Node::eval(const Box &, NamedBox &constbox, const bool) {
-    nat l = constbox.var(name_);
+    nat l = slot_.load(std::memory_order_relaxed);
+    if (l >= constbox.size() || constbox.names()[l] != name_) {
+        l = constbox.var(name_);
+        slot_.store(l, std::memory_order_relaxed);
+    }
     if (l < constbox.size())
         return constbox.val(l);
     std::ostringstream os;
@@ -753,9 +763,39 @@ void RealIfnz_Node::print(std::ostream &os) const {
 }
 
 
+namespace {
+
+    // Maximum number of evaluation states kept by a thread for each kind of node
+    const nat MaxThreadStates = 1024;
+
+    // Evaluation state of the calling thread for the node with the given serial number. States
+    // are a cache: the states of deleted nodes are never reused, since serial numbers are unique,
+    // and when the thread holds too many states the least recently used one is discarded. The
+    // caller shares ownership of the state, since a nested evaluation may discard it.
+    template<typename State>
+    std::shared_ptr<State> threadState(const std::size_t serial) {
+        typedef std::list<std::pair<std::size_t, std::shared_ptr<State> > > Recent;
+        thread_local Recent recent; // Most recently used first
+        thread_local std::unordered_map<std::size_t, typename Recent::iterator> states;
+        auto it = states.find(serial);
+        if (it != states.end()) {
+            recent.splice(recent.begin(), recent, it->second);
+            return it->second->second;
+        }
+        if (states.size() >= MaxThreadStates) {
+            states.erase(recent.back().first);
+            recent.pop_back();
+        }
+        std::shared_ptr<State> state(new State());
+        recent.push_front(std::make_pair(serial, state));
+        states[serial] = recent.begin();
+        return state;
+    }
+}
+
 // --- Polynomial_Node ---
 
-Polynomial_Node::Polynomial_Node(const Monomials &monoms, const Names &names) {
+Polynomial_Node::Polynomial_Node(const Monomials &monoms, const Names &names) : serial_(newSerial()) {
     numOfVariables = 0;
     names_ = names;
     monoms_.resize(monoms.size());
@@ -777,6 +817,10 @@ Polynomial_Node::Polynomial_Node(const Monomials &monoms, const Names &names) {
     realExpressionType_ = POLYNOMIAL;
 }
 
+std::shared_ptr<Polynomial_Node::State> Polynomial_Node::state() const {
+    return threadState<State>(serial_);
+}
+
 Real Polynomial_Node::deriv(const nat v) const {
     Monomials monoms;
     for (nat j = 0; j < nterms(); ++j) {
@@ -796,173 +840,52 @@ Interval Polynomial_Node::eval_poly(const Box &box, NamedBox &constbox) const {
     return X;
 }
 
-bool Polynomial_Node::isMonotone(const nat v) {
+bool Polynomial_Node::isMonotone(State &st, const nat v) const {
 
-    // sufficient test(s) for (non-strict) monotonicity
+    // Sufficient test for (non-strict) monotonicity: the Bernstein coefficients of the
+    // partial derivative in v are, up to a positive factor, the differences of consecutive
+    // coefficients in direction v. They are bounded term by term over all multi-indices.
 
-    if (m_[v] == UNK) {
-        // Only apply these tests in the case of a single-orthant box
-        // (for the time being, at least -> can potentially implement
-        // weaker tests for non-single-orthant cases)
-        // assert(s_ == 0);
-
-        if (B_[v].isPoint()) {
-            m_[v] = CNST;
+    if (st.m_[v] == UNK) {
+        if (degs_[v] == 0 || st.B_[v].isPoint()) {
+            st.m_[v] = CNST;
             return true;
         }
-
-        // ut: uniqueness test: 2 = constant, 1 = unique, 0- = 2 or more occ.
-        int ut = 2;
-        nat ct;
+        Interval diff = 0;
         for (nat j = 0; j < nterms(); ++j) { // for each term
-            if (sne(b_[v][j][0], b_[v][j][degs_[v]])) {
-                --ut;
-                ct = j;
-            }
-            if (ut <= 0) break;
-        }
-        if (ut == 2) {
-            m_[v] = CNST;
-            return true;
-        }
-        if (inf(a_[ct]) < 0 && sup(a_[ct]) > 0) --ut;
-        // cannot succeed if coefficient of unique term is both positive/negative
-        if (ut == 1) {
-            int parity = 1;
+            if (monoms_[j].expo(v) == 0) continue;
+            Interval tmp = st.b_[v][j][1] - st.b_[v][j][0];
+            for (nat ii = 1; ii < degs_[v]; ++ii)
+                tmp = hull(tmp, st.b_[v][j][ii + 1] - st.b_[v][j][ii]);
+            tmp *= st.a_[j];
             for (nat i = 0; i < numberOfVariables(); ++i) {
-                if (i == v) {
-                    if (inf(b_[i][ct][0]) > inf(b_[i][ct][degs_[i]])) parity *= -1;
-                } else if (inf(b_[i][ct][0]) < 0)
-                    parity *= -1;
-                else if (inf(b_[i][ct][degs_[i]]) < 0)
-                    parity *= -1;
-            }
-            if (inf(a_[ct]) < 0) parity *= -1;
-            if (parity == 1) {
-                m_[v] = INC;
-                return true;
-            } else {
-                m_[v] = DEC;
-                return true;
+                if (i == v || monoms_[j].expo(i) == 0) continue;
+                Interval range = st.b_[i][j][0];
+                for (nat ii = 1; ii <= degs_[i]; ++ii)
+                    range = hull(range, st.b_[i][j][ii]);
+                tmp *= range;
             }
+            diff += tmp;
         }
-
-        // Monotonicity test
-        nat n_it, n_dt, n_bt, n_ct; // number of inc/dec/both/constant terms
-        n_it = n_dt = n_bt = n_ct = 0;
-        Ints behaviour; // 0 = constant, -1 = dec, 1 = inc, 2 = both/borked
-        behaviour.assign(nterms(), 0);
-        for (nat j = 0; j < nterms(); ++j) { // for each term
-            if (sne(b_[v][j][0], b_[v][j][degs_[v]])) {
-                behaviour[j] = 0;
-                ++n_ct;
-            } else if (inf(a_[j]) < 0 && sup(a_[j]) > 0) {
-                behaviour[j] = 2;
-                ++n_bt;
-            } else {
-                int parity = 1;
-                for (nat i = 0; i < numberOfVariables(); ++i) {
-                    if (i == v) {
-                        if (inf(b_[i][j][0]) > inf(b_[i][j][degs_[i]])) parity *= -1;
-                    } else if (inf(b_[i][j][0]) < 0)
-                        parity *= -1;
-                    else if (inf(b_[i][j][degs_[i]]) < 0)
-                        parity *= -1;
-                }
-                if (inf(a_[j]) < 0) parity *= -1;
-                behaviour[j] = parity;
-                if (parity == 1) ++n_it;
-                else ++n_dt;
-            }
-        }
-        if ((n_dt == 0) && (n_bt == 0)) {
-            m_[v] = INC;
-            return true;
-        } else if ((n_it == 0) && (n_bt == 0)) {
-            m_[v] = DEC;
-            return true;
-        }
-
-        // Dominance test
-        Interval diffinc, diffdec, tmp1, tmp2;
-        // check for inc >>> dec dominance
-        diffinc = diffdec = 0;
-        for (nat j = 0; j < nterms(); ++j) { // for each term
-            if (behaviour[j] == 0) continue;
-            if (behaviour[j] == 1) {
-                tmp1 = hull(b_[v][j][0], b_[v][j][1]);
-                tmp2 = hull(b_[v][j][degs_[v] - 1], b_[v][j][degs_[v]]);
-                if (width(tmp2) > width(tmp1)) tmp1 = tmp2;
-                tmp1 = tmp1 * a_[j];
-                for (nat i = 0; i < numberOfVariables(); ++i) {
-                    if (i == v) continue;
-                    tmp2 = power(B_[i], monoms_[j].expo(i));
-                    if (sup(tmp2) < 0) tmp1 = tmp1*-inf(tmp2);
-                    else if (inf(tmp2) > 0) tmp1 = tmp1 * sup(tmp2);
-                }
-                diffinc = diffinc + tmp1;
-            } else if ((behaviour[j] == -1) || (behaviour[j] == 2)) {
-                tmp1 = hull(b_[v][j][0], b_[v][j][degs_[v]]);
-                tmp1 = tmp1 * a_[j];
-                for (nat i = 0; i < numberOfVariables(); ++i) {
-                    if (i == v) continue;
-                    tmp2 = power(B_[i], monoms_[j].expo(i));
-                    if (sup(tmp2) < 0) tmp1 = tmp1*-inf(tmp2);
-                    else if (inf(tmp2) > 0) tmp1 = tmp1 * sup(tmp2);
-                }
-                diffdec = diffdec + tmp1;
-            }
-        }
-        if (width(diffinc) > width(diffdec)) {
-            m_[v] = INC;
-            return true;
-        }
-
-        // check for dec >>> inc dominance
-        diffinc = diffdec = 0;
-        for (nat j = 0; j < nterms(); ++j) { // for each term
-            if (behaviour[j] == 0) continue;
-            if (behaviour[j] == -1) {
-                tmp1 = hull(b_[v][j][0], b_[v][j][1]);
-                tmp2 = hull(b_[v][j][degs_[v] - 1], b_[v][j][degs_[v]]);
-                if (width(tmp2) > width(tmp1)) tmp1 = tmp2;
-                tmp1 = tmp1 * a_[j];
-                for (nat i = 0; i < numberOfVariables(); ++i) {
-                    if (i == v) continue;
-                    tmp2 = power(B_[i], monoms_[j].expo(i));
-                    if (sup(tmp2) < 0) tmp1 = tmp1*-inf(tmp2);
-                    else if (inf(tmp2) > 0) tmp1 = tmp1 * sup(tmp2);
-                }
-                diffdec = diffdec + tmp1;
-            } else if ((behaviour[j] == 1) || (behaviour[j] == 2)) {
-                tmp1 = hull(b_[v][j][0], b_[v][j][degs_[v]]);
-                tmp1 = tmp1 * a_[j];
-                for (nat i = 0; i < numberOfVariables(); ++i) {
-                    if (i == v) continue;
-                    tmp2 = power(B_[i], monoms_[j].expo(i));
-                    if (sup(tmp2) < 0) tmp1 = tmp1*-inf(tmp2);
-                    else if (inf(tmp2) > 0) tmp1 = tmp1 * sup(tmp2);
-                }
-                diffinc = diffinc + tmp1;
-            }
-        }
-        if (width(diffdec) > width(diffinc)) {
-            m_[v] = DEC;
-            return true;
-        }
-
-        return false;
+        if (inf(diff) >= 0 && sup(diff) <= 0)
+            st.m_[v] = CNST;
+        else if (inf(diff) >= 0)
+            st.m_[v] = INC;
+        else if (sup(diff) <= 0)
+            st.m_[v] = DEC;
+        else
+            return false;
     }
     return true;
 }
 
-bool Polynomial_Node::diffConstants(NamedBox &constbox) {
+bool Polynomial_Node::diffConstants(const State &st, NamedBox &constbox) const {
     if (localVariables_.empty() && globalConstants_.empty())
         return false;
-    bool diffconsts = C_.empty();
+    bool diffconsts = st.C_.empty();
     if (!diffconsts) {
         for (NameSet::iterator it = localVariables_.begin(); it != localVariables_.end(); ++it) {
-            Interval iC = C_.val(C_.var(*it));
+            Interval iC = st.C_.val(st.C_.var(*it));
             Interval ic = constbox.val(constbox.var(*it));
             if (!iC.seq(ic)) {
                 diffconsts = true;
@@ -972,7 +895,7 @@ bool Polynomial_Node::diffConstants(NamedBox &constbox) {
     }
     if (!diffconsts) {
         for (NameSet::iterator it = globalConstants_.begin(); it != globalConstants_.end(); ++it) {
-            Interval iC = C_.val(C_.var(*it));
+            Interval iC = st.C_.val(st.C_.var(*it));
             Interval ic = constbox.val(constbox.var(*it));
             if (!iC.seq(ic)) {
                 diffconsts = true;
@@ -987,72 +910,254 @@ bool Polynomial_Node::diffConstants(NamedBox &constbox) {
 // diff[i] == 0 : box[i] in B_[i]
 // diff[i] > 0  : box[i] not in B[i] and box[i] != B_[i]
 
-void Polynomial_Node::diffVariables(const Box &box, NamedBox &constbox) {
-    diff_.resize(numberOfVariables());
-    bool diffconsts = diffConstants(constbox);
-    if (B_.empty() || diffconsts) {
-        B_ = box;
-        C_ = constbox;
-        m_.assign(numberOfVariables(), UNK);
-        diff_.assign(numberOfVariables(), 1);
-        b_.resize(numberOfVariables());
-        s_ = 0;
+namespace {
+
+    // Maximum number of nested Bernstein patches kept per variable
+    const nat MaxPatches = 64;
+
+    // Bernstein coefficients of degree deg of the power of variable v in each monomial on X,
+    // computed from the monomial form
+    void bernsteinFromMonomials(const Monomials &monoms, const nat v, const nat deg, const Interval &X,
+                                Boxes &coeffs) {
+        Interval tmp;
+        real wid = width(X);
+        for (nat j = 0; j < monoms.size(); ++j) { // for each term
+            nat kk = monoms[j].expo(v);
+            for (nat ii = 0; ii <= deg; ++ii) { // for each (univariate) BC
+                coeffs[j][ii] = Interval(0);
+                for (nat jj = 0; jj <= ii && jj <= kk; ++jj) {
+                    tmp = Interval(Kodiak::choose(kk, jj)) * power(X.infimum(), kk - jj);
+                    tmp *= Interval(Kodiak::choose(ii, jj)) * power(Interval(wid, wid), jj);
+                    coeffs[j][ii] += tmp / (Interval(Kodiak::choose(deg, jj)));
+                }
+            }
+        }
+    }
+
+    // De Casteljau subdivision of the Bernstein coefficients c on [a,b] at a + t*(b-a), where
+    // t is an enclosure of the split parameter. Keeps the coefficients of the left part if
+    // left, otherwise those of the right part.
+    void casteljau(Box &c, const Interval &t, const bool left) {
+        nat d = c.size() - 1;
+        Interval s = Interval(1) - t;
+        for (nat r = 1; r <= d; ++r) {
+            if (left) {
+                for (nat k = d; k >= r; --k)
+                    c[k] = s * c[k - 1] + t * c[k];
+            } else {
+                for (nat k = 0; k + r <= d; ++k)
+                    c[k] = s * c[k] + t * c[k + 1];
+            }
+        }
+    }
+}
+
+void BernsteinPatches::coefficients(const Monomials &monoms, const nat v, const nat deg, const Interval &X,
+                                    Boxes &coeffs) {
+    while (!patches_.empty() && !X.subset(patches_.back().first))
+        patches_.pop_back();
+    bool bounded = std::isfinite(X.inf()) && std::isfinite(X.sup());
+    if (patches_.empty() || X.isPoint() || !bounded) {
+        bernsteinFromMonomials(monoms, v, deg, X, coeffs);
+        if (bounded && !X.isPoint())
+            patches_.assign(1, std::make_pair(X, coeffs));
+        return;
+    }
+    Interval P = patches_.back().first;
+    coeffs = patches_.back().second;
+    if (X.seq(P))
+        return;
+    Interval a = P.infimum();
+    Interval b = P.supremum();
+    for (nat j = 0; j < coeffs.size(); ++j) {
+        if (X.inf() > P.inf())
+            casteljau(coeffs[j], (X.infimum() - a) / (b - a), false);
+        if (X.sup() < P.sup())
+            casteljau(coeffs[j], (X.supremum() - X.infimum()) / (b - X.infimum()), true);
+    }
+    if (patches_.size() < MaxPatches)
+        patches_.push_back(std::make_pair(X, coeffs));
+}
+
+void Polynomial_Node::diffVariables(State &st, const Box &box, NamedBox &constbox) const {
+    st.diff_.resize(numberOfVariables());
+    bool diffconsts = diffConstants(st, constbox);
+    if (st.B_.empty() || diffconsts) {
+        st.B_ = box;
+        st.C_ = constbox;
+        st.m_.assign(numberOfVariables(), UNK);
+        st.diff_.assign(numberOfVariables(), 1);
+        st.b_.resize(numberOfVariables());
+        st.p_.resize(numberOfVariables());
+        st.s_ = 0;
         for (nat i = 0; i < numberOfVariables(); ++i) {
-            if (inf(B_[i]) < 0 && sup(B_[i]) > 0) ++s_;
-            b_[i].resize(nterms());
+            if (inf(st.B_[i]) < 0 && sup(st.B_[i]) > 0) ++st.s_;
+            st.b_[i].resize(nterms());
             for (nat j = 0; j < nterms(); ++j)
-                b_[i][j].resize(degree(i) + 1);
+                st.b_[i][j].resize(degree(i) + 1);
         }
-        a_.resize(nterms());
+        st.a_.resize(nterms());
         for (nat j = 0; j < nterms(); ++j) {
-            a_[j] = monoms_[j].coeff().eval(box, constbox);
+            st.a_[j] = monoms_[j].coeff().eval(box, constbox);
         }
     } else {
         for (nat i = 0; i < numberOfVariables(); ++i) {
-            if (box[i].seq(B_[i]))
-                diff_[i] = -1;
-            else if (box[i].subset(B_[i]))
-                diff_[i] = 0;
+            if (box[i].seq(st.B_[i]))
+                st.diff_[i] = -1;
+            else if (box[i].subset(st.B_[i]))
+                st.diff_[i] = 0;
             else
-                diff_[i] = 1;
-            if (diff_[i] >= 0) { // B_[i] and box[i] are different 
-                if (inf(B_[i]) < 0 && sup(B_[i]) > 0) {
-                    if (inf(box[i]) >= 0 || sup(box[i]) <= 0) --s_;
+                st.diff_[i] = 1;
+            if (st.diff_[i] >= 0) { // B_[i] and box[i] are different 
+                if (inf(st.B_[i]) < 0 && sup(st.B_[i]) > 0) {
+                    if (inf(box[i]) >= 0 || sup(box[i]) <= 0) --st.s_;
                 } else {
-                    if (inf(box[i]) < 0 && sup(box[i]) > 0) ++s_;
+                    if (inf(box[i]) < 0 && sup(box[i]) > 0) ++st.s_;
                 }
-                if (diff_[i] > 0) // B_[i] and box[i] are different and box[i] is not included in B_[i]
-                    // then reset monotonicity information, since it's not longer valid.
-                    m_[i] = UNK;
-                B_[i] = box[i];
+                st.B_[i] = box[i];
+            }
+        }
+        // Monotonicity information remains valid on subboxes only
+        for (nat i = 0; i < numberOfVariables(); ++i) {
+            if (st.diff_[i] > 0) {
+                st.m_.assign(numberOfVariables(), UNK);
+                break;
             }
         }
     }
 }
 
-Interval Polynomial_Node::eval_bp(const Box &box, NamedBox &constbox) {
-    diffVariables(box, constbox);
-    Interval tmp;
-    real wid;
-    for (nat i = 0; i < numberOfVariables(); ++i) { // for each variable
-        if (diff_[i] >= 0) {
-            wid = width(box[i]);
-            for (nat j = 0; j < nterms(); ++j) { // for each term
-                nat kk = monoms_[j].expo(i);
-                for (nat ii = 0; ii <= degs_[i]; ++ii) { // for each (univariate) BC
-                    b_[i][j][ii] = Interval(0);
-                    for (nat jj = 0; jj <= ii && jj <= kk; ++jj) {
-                        tmp = Interval(Kodiak::choose(kk, jj)) * power(box[i].infimum(), kk - jj);
-                        tmp *= Interval(Kodiak::choose(ii, jj)) * power(Interval(wid, wid), jj);
-                        b_[i][j][ii] += tmp / (Interval(Kodiak::choose(degs_[i], jj)));
-                    }
+namespace {
+
+    // Maximum number of partial multi-indices expanded by a search of the implicit Bernstein form
+    const nat MaxBernsteinNodes = 4096;
+
+    /* ImplicitBernstein
+     * Bernstein coefficients of a polynomial in implicit form. The coefficient of multi-index I
+     * is the sum over the terms j of a[j] * prod_i b[i][j][I_i], where the product only ranges
+     * over the variables that occur in term j. The least (or greatest) coefficient over a box of
+     * multi-indices is found by a best-first search on partial multi-indices, whose coefficients
+     * are enclosed term by term. When the search runs out of nodes, the best enclosure of the
+     * pending partial multi-indices is used instead, so the result is still a bound of the
+     * coefficients.
+     */
+    class ImplicitBernstein {
+    public:
+
+        ImplicitBernstein(const BCoeffs &b, const Box &a, const Monomials &monoms) :
+                b_(b), a_(a), vars_(b.size()), min_(true) {
+            for (nat i = 0; i < b.size(); ++i)
+                for (nat j = 0; j < monoms.size(); ++j)
+                    if (monoms[j].expo(i) > 0)
+                        vars_[i].push_back(j);
+        }
+
+        // Updates best with the least (if min) or greatest Bernstein coefficient whose multi-index
+        // is in [lo,hi]
+        void search(const Tuple &lo, const Tuple &hi, const bool min, Interval &best) {
+            min_ = min;
+            // Variables with a single index are multiplied out first, then the others are
+            // searched in decreasing number of occurrences
+            Box partial = a_;
+            order_.clear();
+            for (nat i = 0; i < b_.size(); ++i) {
+                if (vars_[i].empty()) continue;
+                if (lo[i] == hi[i]) {
+                    for (nat j: vars_[i])
+                        partial[j] *= b_[i][j][lo[i]];
+                } else
+                    order_.push_back(i);
+            }
+            std::stable_sort(order_.begin(), order_.end(), [this](const nat u, const nat v) {
+                return vars_[u].size() > vars_[v].size();
+            });
+            // range_[k][j]: enclosure of the factors of term j in variables order_[k..]
+            nat n = order_.size();
+            range_.assign(n + 1, Box(a_.size(), Interval(1)));
+            for (nat k = n; k-- > 0;) {
+                nat i = order_[k];
+                range_[k] = range_[k + 1];
+                for (nat j: vars_[i]) {
+                    Interval h = b_[i][j][lo[i]];
+                    for (nat ii = lo[i] + 1; ii <= hi[i]; ++ii)
+                        h = hull(h, b_[i][j][ii]);
+                    range_[k][j] *= h;
+                }
+            }
+            std::priority_queue<Pending> pending;
+            pending.push(Pending(key(bound(0, partial)), 0, partial));
+            for (nat nodes = 0; !pending.empty(); ++nodes) {
+                Pending top = pending.top();
+                if (!improves(top.key, best)) return;
+                if (top.depth == n) {
+                    best = bound(n, top.partial);
+                    return;
+                }
+                if (nodes == MaxBernsteinNodes) {
+                    best = bound(top.depth, top.partial);
+                    return;
+                }
+                pending.pop();
+                nat i = order_[top.depth];
+                for (nat ii = lo[i]; ii <= hi[i]; ++ii) {
+                    Box child = top.partial;
+                    for (nat j: vars_[i])
+                        child[j] *= b_[i][j][ii];
+                    Interval e = bound(top.depth + 1, child);
+                    if (improves(key(e), best))
+                        pending.push(Pending(key(e), top.depth + 1, child));
                 }
             }
         }
+
+    private:
+
+        // Partial multi-index, where the factors of the first depth variables are multiplied out
+        struct Pending {
+            Pending(const real k, const nat d, const Box &p) : key(k), depth(d), partial(p) {
+            }
+
+            bool operator<(const Pending &other) const {
+                return key > other.key;
+            }
+            real key; // Lower bound of the coefficients (upper bound negated, when maximizing)
+            nat depth; // Number of variables multiplied out
+            Box partial; // Product of the coefficient and the factors of each term so far
+        };
+
+        Interval bound(const nat k, const Box &partial) const {
+            Interval e = 0;
+            for (nat j = 0; j < partial.size(); ++j)
+                e += partial[j] * range_[k][j];
+            return e;
+        }
+
+        real key(const Interval &e) const {
+            return min_ ? inf(e) : -sup(e);
+        }
+
+        bool improves(const real k, const Interval &best) const {
+            return k < key(best);
+        }
+
+        const BCoeffs &b_;
+        const Box &a_;
+        std::vector<Tuple> vars_; // Terms where each variable occurs
+        Tuple order_; // Variables searched, in order
+        std::vector<Box> range_; // Enclosures of the remaining factors of each term
+        bool min_; // Search for the least coefficient
+    };
+}
+
+Interval Polynomial_Node::eval_bp(State &st, const Box &box, NamedBox &constbox) const {
+    diffVariables(st, box, constbox);
+    for (nat i = 0; i < numberOfVariables(); ++i) { // for each variable
+        if (st.diff_[i] >= 0)
+            st.p_[i].coefficients(monoms_, i, degs_[i], box[i], st.b_[i]);
     }
 
     // Bernstein enclosure with automatic choice of potential speedup (psu)
-    bool psu = (s_ == 0 && numberOfVariables() >= 3);
+    bool psu = (numberOfVariables() >= 3);
 
     Tuple s_min, s_max; // multiindex search space for min BC
     Tuple t_min, t_max; // multiindex search space for max BC
@@ -1065,12 +1170,12 @@ Interval Polynomial_Node::eval_bp(const Box &box, NamedBox &constbox) {
 
     if (psu) {
         for (nat i = 0; i < numberOfVariables(); ++i) {
-            if (isMonotone(i)) {
+            if (isMonotone(st, i)) {
                 mono = true;
-                if (m_[i] == INC) {
+                if (st.m_[i] == INC) {
                     s_max[i] = 0;
                     t_min[i] = degs_[i];
-                } else if (m_[i] == DEC) {
+                } else if (st.m_[i] == DEC) {
                     s_min[i] = degs_[i];
                     t_max[i] = 0;
                 } else { // In this case m_[i] = CNST
@@ -1095,94 +1200,20 @@ Interval Polynomial_Node::eval_bp(const Box &box, NamedBox &constbox) {
     // Initialise bmin, bmax
     for (nat i = 0; i < numberOfVariables(); ++i) { // for each variable
         for (nat j = 0; j < nterms(); ++j) { // for each term
-            tmb[j] *= b_[i][j][0]; // degree 0
+            tmb[j] *= st.b_[i][j][0]; // degree 0
         }
     }
 
     bmin = 0;
-    for (nat j = 0; j < nterms(); ++j) bmin += tmb[j] * a_[j];
+    for (nat j = 0; j < nterms(); ++j) bmin += tmb[j] * st.a_[j];
     bmax = bmin;
 
     // Compute necessary BCs
-    // Optimised version where intermediate products are stored in tmb
-    if (numberOfVariables() >= 3) { // only use this version for non-trivial degree
-
-        Box tmb2;
-        Tuple blocksize, tmbsize;
-        nat tmbsizetotal = 1;
-        // compute the sizes of the temporary vector of BCs, tmbsize
-        tmbsize.assign(numberOfVariables(), 1);
-        for (nat i = 0; i < numberOfVariables(); ++i) { // for each variable
-            if ((s_min[i] != s_max[i]) || (t_min[i] != t_max[i])) tmbsize[i] = degs_[i] + 1;
-            else if (s_min[i] != t_min[i]) tmbsize[i] = 2;
-            tmbsizetotal *= tmbsize[i]; // total number of BCs to be computed
-        }
-        tmb.assign(tmbsizetotal, Interval(0));
-        // tmb/tmb2 indexing:
-        // tmb[i_0]...[i_(n-1)] = tmb[i_(n-1)*blocksize[n-1]+...+i_0]
-
-        blocksize.resize(numberOfVariables());
-        blocksize[0] = 1;
-        for (nat i = 1; i < numberOfVariables(); ++i)
-            blocksize[i] = blocksize[i - 1] * tmbsize[i - 1];
-
-        for (nat j = 0; j < nterms(); ++j) { // for each term
-            //      nat reduced = 0;   // does this term have zero exponents?
-            tmb2.assign(tmbsizetotal, Interval(1));
-            tmb2[0] = a_[j];
-            for (nat i = 0; i < numberOfVariables(); ++i) { // for each variable
-                //        if (monos_[j].expo(i)!=0 && tmbsize[i]!=1) {
-                //        later to restore when optimising for zero-exponent terms
-                if (tmbsize[i] != 1) {
-                    if (tmbsize[i] == 2) {
-                        Interval bt = b_[i][j][degs_[i]];
-                        nat offset = blocksize[i];
-                        for (nat iii = 0; iii < blocksize[i]; ++iii)
-                            tmb2[iii + offset] = tmb2[iii] * bt;
-                    } else {
-                        for (nat ii = 1; ii < tmbsize[i]; ++ii) {
-                            // for each univariate coeff except the first
-                            Interval bt = b_[i][j][ii];
-                            nat offset = blocksize[i] * ii;
-                            for (nat iii = 0; iii < blocksize[i]; ++iii)
-                                tmb2[iii + offset] = tmb2[iii] * bt;
-                        }
-                    }
-                }
-                for (nat iii = 0; iii < blocksize[i]; ++iii)
-                    tmb2[iii] *= b_[i][j][0];
-            }
-            // iterate over tmbsizetotal, add tmb2 to tmb
-            // basic version
-            //      if (reduced==0)
-            for (nat iii = 0; iii < tmbsizetotal; ++iii)
-                tmb[iii] += tmb2[iii];
-            // optimised version for terms with some zero exponents
-            /*
-            else {
-              nat iiii = 0;
-              for (nat iii=0; iii<tmbsizetotal; ++iii)
-                tmb[iii] += tmb2[iiii];
-
-            }
-             */
-
-            // can further optimise for zero-exponent terms
-            // tricky; currently disabled
-            // for example:   add if (reductionfactor>1)
-            /*
-            for (nat iii=0; iii<(tmbsizetotal/reductionfactor); ++iii)
-              for (nat iiii=0; iiii<reductionfactor; ++iiii)
-                tmb[iii*reductionfactor+iiii] += tmb2[iii];
-             */
-            // need to change above
-
-        }
-        for (nat iii = 0; iii < tmbsizetotal; ++iii) {
-            if (inf(tmb[iii]) < inf(bmin)) bmin = tmb[iii];
-            if (sup(tmb[iii]) > sup(bmax)) bmax = tmb[iii];
-        }
-
+    // Implicit version where the products of each term are expanded lazily
+    if (numberOfVariables() >= 3) {
+        ImplicitBernstein bernstein(st.b_, st.a_, monoms_);
+        bernstein.search(s_min, s_max, true, bmin);
+        bernstein.search(t_min, t_max, false, bmax);
     } else { // old version - should be used where numberOfVariables is <= 2?
 
         // Compute BCs for bmin
@@ -1197,18 +1228,18 @@ Interval Polynomial_Node::eval_bp(const Box &box, NamedBox &constbox) {
             for (nat ii = 0; ii < numberOfVariables(); ++ii) { // for each variable
                 for (nat jj = 0; jj < nterms(); ++jj) { // for each term
                     if (i < b_min_size)
-                        tmbmin[jj] *= b_[ii][jj][idx_min[ii]]; // degree idx_min[ii]
+                        tmbmin[jj] *= st.b_[ii][jj][idx_min[ii]]; // degree idx_min[ii]
                     if (mono && i < b_max_size)
-                        tmbmax[jj] *= b_[ii][jj][idx_max[ii]]; // degree idx_min[ii]
+                        tmbmax[jj] *= st.b_[ii][jj][idx_max[ii]]; // degree idx_min[ii]
                 }
             }
             bcmin = 0;
             bcmax = 0;
             for (nat j = 0; j < nterms(); ++j) {
                 if (i < b_min_size)
-                    bcmin += tmbmin[j] * a_[j];
+                    bcmin += tmbmin[j] * st.a_[j];
                 if (mono && i < b_max_size)
-                    bcmax += tmbmax[j] * a_[j];
+                    bcmax += tmbmax[j] * st.a_[j];
             }
             if (!mono) bcmax = bcmin;
             if (i < b_min_size) {
@@ -1243,7 +1274,7 @@ Interval Polynomial_Node::eval_bp(const Box &box, NamedBox &constbox) {
 
 Interval Polynomial_Node::eval(const Box &box, NamedBox &constbox, const bool enclosure) {
     if (enclosure)
-        return eval_bp(box, constbox);
+        return eval_bp(*state(), box, constbox);
     else
         return eval_poly(box, constbox);
 }
@@ -1272,14 +1303,16 @@ void Polynomial_Node::print(std::ostream &os) const {
 }
 
 void Polynomial_Node::print_metadata(std::ostream &os) const {
-    os << "*** B_ = " << B_ << std::endl;
-    os << "*** s_: " << s_ << std::endl;
+    std::shared_ptr<State> state = this->state();
+    const State &st = *state;
+    os << "*** B_ = " << st.B_ << std::endl;
+    os << "*** s_: " << st.s_ << std::endl;
     os << "*** degs_: " << degs_ << std::endl;
-    os << "*** m_: " << m_ << std::endl;
+    os << "*** m_: " << st.m_ << std::endl;
     for (nat j = 0; j < nterms(); ++j) {
-        os << "Term " << j + 1 << ", coefficient: " << a_[j] << ":" << std::endl;
+        os << "Term " << j + 1 << ", coefficient: " << st.a_[j] << ":" << std::endl;
         for (nat i = 0; i < numberOfVariables(); ++i) {
-            os << var_name(i) << ": " << b_[i][j] << std::endl;
+            os << var_name(i) << ": " << st.b_[i][j] << std::endl;
         }
     }
     os << std::endl;
@@ -1291,7 +1324,8 @@ nat Polynomial_Node::degree(const nat v) const { // degree in variable v
     return degs_[v];
 }
 
-Rational_Node::Rational_Node(const Monomials &nummonoms, const Monomials &denmonoms, const Names &names) {
+Rational_Node::Rational_Node(const Monomials &nummonoms, const Monomials &denmonoms, const Names &names) :
+        serial_(newSerial()) {
     numOfVariables = 0;
     names_ = names;
     num_monoms_.resize(nummonoms.size());
@@ -1329,6 +1363,10 @@ Rational_Node::Rational_Node(const Monomials &nummonoms, const Monomials &denmon
     realExpressionType_ = RATIONAL;
 }
 
+std::shared_ptr<Rational_Node::State> Rational_Node::state() const {
+    return threadState<State>(serial_);
+}
+
 Real Rational_Node::deriv(const nat v) const {
 
     // Compute monomials for derivative of numerator and denominator
@@ -1381,41 +1419,14 @@ Interval Rational_Node::eval_rat(const Box &box, NamedBox &constbox) const {
 
 }
 
-Interval Rational_Node::eval_bp(const Box &box, NamedBox &constbox) {
+Interval Rational_Node::eval_bp(State &st, const Box &box, NamedBox &constbox) const {
 
-    diffVariables(box, constbox);
-    Interval tmp;
-    real wid;
+    diffVariables(st, box, constbox);
     for (nat i = 0; i < numberOfVariables(); ++i) // for each variable
     {
-        if (diff_[i] >= 0) {
-            wid = width(box[i]);
-            for (nat j = 0; j < numnterms(); ++j) // for each numerator term
-            {
-                nat kk = num_monoms_[j].expo(i);
-                for (nat ii = 0; ii <= degs_[i]; ++ii) // for each (univariate) BC
-                {
-                    num_b_[i][j][ii] = Interval(0);
-                    for (nat jj = 0; jj <= ii && jj <= kk; ++jj) {
-                        tmp = Interval(Kodiak::choose(kk, jj)) * power(box[i].infimum(), kk - jj);
-                        tmp *= Interval(Kodiak::choose(ii, jj)) * power(Interval(wid, wid), jj);
-                        num_b_[i][j][ii] += tmp / (Interval(Kodiak::choose(degs_[i], jj)));
-                    }
-                }
-            }
-            for (nat j = 0; j < dennterms(); ++j) // for each denominator term
-            {
-                nat kk = den_monoms_[j].expo(i);
-                for (nat ii = 0; ii <= degs_[i]; ++ii) // for each (univariate) BC
-                {
-                    den_b_[i][j][ii] = Interval(0);
-                    for (nat jj = 0; jj <= ii && jj <= kk; ++jj) {
-                        tmp = Interval(Kodiak::choose(kk, jj)) * power(box[i].infimum(), kk - jj);
-                        tmp *= Interval(Kodiak::choose(ii, jj)) * power(Interval(wid, wid), jj);
-                        den_b_[i][j][ii] += tmp / (Interval(Kodiak::choose(degs_[i], jj)));
-                    }
-                }
-            }
+        if (st.diff_[i] >= 0) {
+            st.num_p_[i].coefficients(num_monoms_, i, degs_[i], box[i], st.num_b_[i]);
+            st.den_p_[i].coefficients(den_monoms_, i, degs_[i], box[i], st.den_b_[i]);
         }
     }
 
@@ -1435,19 +1446,19 @@ Interval Rational_Node::eval_bp(const Box &box, NamedBox &constbox) {
     {
         for (nat j = 0; j < numnterms(); ++j) // for each numerator term
         {
-            tmbn[j] *= num_b_[i][j][0]; // degree 0
+            tmbn[j] *= st.num_b_[i][j][0]; // degree 0
         }
         for (nat j = 0; j < dennterms(); ++j) // for each denominator term
         {
-            tmbd[j] *= den_b_[i][j][0]; // degree 0
+            tmbd[j] *= st.den_b_[i][j][0]; // degree 0
         }
     }
 
     int densign; // sign of denominator; +1 for positive, -1 for negative
     btn = 0;
-    for (nat j = 0; j < numnterms(); ++j) btn += tmbn[j] * num_a_[j];
+    for (nat j = 0; j < numnterms(); ++j) btn += tmbn[j] * st.num_a_[j];
     btd = 0;
-    for (nat j = 0; j < dennterms(); ++j) btd += tmbd[j] * den_a_[j];
+    for (nat j = 0; j < dennterms(); ++j) btd += tmbd[j] * st.den_a_[j];
     if (btd.contains(0)) {
         throw Growl("Kodiak (eval): division by an interval that contains zero");
     }
@@ -1467,23 +1478,23 @@ Interval Rational_Node::eval_bp(const Box &box, NamedBox &constbox) {
             for (nat jj = 0; jj < numnterms(); ++jj) // for each numerator term
             {
                 if (i < b_size)
-                    tmbn[jj] *= num_b_[ii][jj][midx[ii]]; // degree idx_min[ii]
+                    tmbn[jj] *= st.num_b_[ii][jj][midx[ii]]; // degree idx_min[ii]
             }
             for (nat jj = 0; jj < dennterms(); ++jj) // for each denominator term
             {
                 if (i < b_size)
-                    tmbd[jj] *= den_b_[ii][jj][midx[ii]]; // degree idx_min[ii]
+                    tmbd[jj] *= st.den_b_[ii][jj][midx[ii]]; // degree idx_min[ii]
             }
         }
         btn = 0;
         btd = 0;
         for (nat j = 0; j < numnterms(); ++j) {
             if (i < b_size)
-                btn += tmbn[j] * num_a_[j];
+                btn += tmbn[j] * st.num_a_[j];
         }
         for (nat j = 0; j < dennterms(); ++j) {
             if (i < b_size)
-                btd += tmbd[j] * den_a_[j];
+                btd += tmbd[j] * st.den_a_[j];
         }
         if (btd.contains(0)) {
             throw Growl("Kodiak (eval): division by an interval that contains zero");
@@ -1512,20 +1523,20 @@ Interval Rational_Node::eval_bp(const Box &box, NamedBox &constbox) {
 
 Interval Rational_Node::eval(const Box &box, NamedBox &constbox, const bool enclosure) {
     if (enclosure)
-        return eval_bp(box, constbox);
+        return eval_bp(*state(), box, constbox);
     else
         return eval_rat(box, constbox);
 }
 
 // diffConstants is identical to the Polynomial_Node version
 
-bool Rational_Node::diffConstants(NamedBox &constbox) {
+bool Rational_Node::diffConstants(const State &st, NamedBox &constbox) const {
     if (localVariables_.empty() && globalConstants_.empty())
         return false;
-    bool diffconsts = C_.empty();
+    bool diffconsts = st.C_.empty();
     if (!diffconsts) {
         for (NameSet::iterator it = localVariables_.begin(); it != localVariables_.end(); ++it) {
-            Interval iC = C_.val(C_.var(*it));
+            Interval iC = st.C_.val(st.C_.var(*it));
             Interval ic = constbox.val(constbox.var(*it));
             if (!iC.seq(ic)) {
                 diffconsts = true;
@@ -1535,7 +1546,7 @@ bool Rational_Node::diffConstants(NamedBox &constbox) {
     }
     if (!diffconsts) {
         for (NameSet::iterator it = globalConstants_.begin(); it != globalConstants_.end(); ++it) {
-            Interval iC = C_.val(C_.var(*it));
+            Interval iC = st.C_.val(st.C_.var(*it));
             Interval ic = constbox.val(constbox.var(*it));
             if (!iC.seq(ic)) {
                 diffconsts = true;
@@ -1552,43 +1563,45 @@ bool Rational_Node::diffConstants(NamedBox &constbox) {
 // Monotonicity information (m_) and number of intervals containing
 //  zero (s_) is not recorded for rational nodes
 
-void Rational_Node::diffVariables(const Box &box, NamedBox &constbox) {
-    diff_.resize(numberOfVariables());
-    bool diffconsts = diffConstants(constbox);
-    if (B_.empty() || diffconsts) {
-        B_ = box;
-        C_ = constbox;
-        diff_.assign(numberOfVariables(), 1);
+void Rational_Node::diffVariables(State &st, const Box &box, NamedBox &constbox) const {
+    st.diff_.resize(numberOfVariables());
+    bool diffconsts = diffConstants(st, constbox);
+    if (st.B_.empty() || diffconsts) {
+        st.B_ = box;
+        st.C_ = constbox;
+        st.diff_.assign(numberOfVariables(), 1);
         // Numerator and denominator are required to have same (number of)
         // variables, same degrees in each, but may have different numbers of terms
-        num_b_.resize(numberOfVariables());
-        den_b_.resize(numberOfVariables());
+        st.num_b_.resize(numberOfVariables());
+        st.den_b_.resize(numberOfVariables());
+        st.num_p_.resize(numberOfVariables());
+        st.den_p_.resize(numberOfVariables());
         for (nat i = 0; i < numberOfVariables(); ++i) {
-            num_b_[i].resize(numnterms());
+            st.num_b_[i].resize(numnterms());
             for (nat j = 0; j < numnterms(); ++j)
-                num_b_[i][j].resize(degree(i) + 1);
-            den_b_[i].resize(dennterms());
+                st.num_b_[i][j].resize(degree(i) + 1);
+            st.den_b_[i].resize(dennterms());
             for (nat j = 0; j < dennterms(); ++j)
-                den_b_[i][j].resize(degree(i) + 1);
+                st.den_b_[i][j].resize(degree(i) + 1);
         }
-        num_a_.resize(numnterms());
+        st.num_a_.resize(numnterms());
         for (nat j = 0; j < numnterms(); ++j) {
-            num_a_[j] = num_monoms_[j].coeff().eval(box, constbox);
+            st.num_a_[j] = num_monoms_[j].coeff().eval(box, constbox);
         }
-        den_a_.resize(dennterms());
+        st.den_a_.resize(dennterms());
         for (nat j = 0; j < dennterms(); ++j) {
-            den_a_[j] = den_monoms_[j].coeff().eval(box, constbox);
+            st.den_a_[j] = den_monoms_[j].coeff().eval(box, constbox);
         }
     } else {
         for (nat i = 0; i < numberOfVariables(); ++i) {
-            if (box[i].seq(B_[i]))
-                diff_[i] = -1;
-            else if (box[i].subset(B_[i]))
-                diff_[i] = 0;
+            if (box[i].seq(st.B_[i]))
+                st.diff_[i] = -1;
+            else if (box[i].subset(st.B_[i]))
+                st.diff_[i] = 0;
             else
-                diff_[i] = 1;
-            if (diff_[i] >= 0) // B_[i] and box[i] are different
-                B_[i] = box[i];
+                st.diff_[i] = 1;
+            if (st.diff_[i] >= 0) // B_[i] and box[i] are different
+                st.B_[i] = box[i];
         }
     }
 }
@@ -1629,21 +1642,23 @@ void Rational_Node::print(std::ostream &os) const {
 }
 
 void Rational_Node::print_metadata(std::ostream &os) const {
-    os << "*** B_ = " << B_ << std::endl;
+    std::shared_ptr<State> state = this->state();
+    const State &st = *state;
+    os << "*** B_ = " << st.B_ << std::endl;
     os << "*** degs_: " << degs_ << std::endl;
     os << "numerator: ";
     for (nat j = 0; j < numnterms(); ++j) {
-        os << "Term " << j + 1 << ", coefficient: " << num_a_[j] << ":" << std::endl;
+        os << "Term " << j + 1 << ", coefficient: " << st.num_a_[j] << ":" << std::endl;
         for (nat i = 0; i < numberOfVariables(); ++i) {
-            os << var_name(i) << ": " << num_b_[i][j] << std::endl;
+            os << var_name(i) << ": " << st.num_b_[i][j] << std::endl;
         }
     }
     os << std::endl;
     os << "denominator: ";
     for (nat j = 0; j < dennterms(); ++j) {
-        os << "Term " << j + 1 << ", coefficient: " << den_a_[j] << ":" << std::endl;
+        os << "Term " << j + 1 << ", coefficient: " << st.den_a_[j] << ":" << std::endl;
         for (nat i = 0; i < numberOfVariables(); ++i) {
-            os << var_name(i) << ": " << den_b_[i][j] << std::endl;
+            os << var_name(i) << ": " << st.den_b_[i][j] << std::endl;
         }
     }
     os << std::endl;
@@ -1793,4 +1808,187 @@ std::ostream &kodiak::operator<<(std::ostream &os, const MonoInfo monoinfo) {
     return os;
 }
 
+// --- Hash-consing ---
+
+void Node::mix(std::size_t &h, const std::size_t v) {
+    h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+}
+
+bool Node::mix(std::size_t &h, const Real &e) {
+    if (e.notAReal()) {
+        mix(h, 0);
+        return true;
+    }
+    if (!e.node_->interned_)
+        return false;
+    mix(h, e.node_->hash_);
+    return true;
+}
 
+bool Node::same(const Real &e1, const Real &e2) {
+    return e1.node_ == e2.node_;
+}
+
+std::size_t Node::newSerial() {
+    static std::atomic<std::size_t> serial(0);
+    return ++serial;
+}
+
+namespace {
+
+    // Same double, including the sign of zero
+    bool sameReal(const real x, const real y) {
+        return x == y && std::signbit(x) == std::signbit(y);
+    }
+}
+
+bool RealVal_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    if (!val_.isEmpty()) {
+        mix(h, std::hash<real>()(val_.inf()));
+        mix(h, std::hash<real>()(val_.sup()));
+    }
+    return true;
+}
+
+bool RealVal_Node::isIdentical(Node const &other) const {
+    const Interval &val = static_cast<RealVal_Node const &>(other).val_;
+    if (val_.isEmpty() || val.isEmpty())
+        return val_.isEmpty() && val.isEmpty();
+    return sameReal(val_.inf(), val.inf()) && sameReal(val_.sup(), val.sup());
+}
+
+bool RealVar_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    mix(h, var_);
+    return true;
+}
+
+bool RealVar_Node::isIdentical(Node const &other) const {
+    auto &otherVarNode = static_cast<RealVar_Node const &>(other);
+    return var_ == otherVarNode.var_ && name_ == otherVarNode.name_;
+}
+
+bool RealName_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    mix(h, std::hash<std::string>()(name_));
+    return true;
+}
+
+bool RealName_Node::isIdentical(Node const &other) const {
+    auto &otherNameNode = static_cast<RealName_Node const &>(other);
+    return name_ == otherNameNode.name_ && local_ == otherNameNode.local_;
+}
+
+bool RealUnary_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    mix(h, op_);
+    return mix(h, ope_);
+}
+
+bool RealUnary_Node::isIdentical(Node const &other) const {
+    auto &otherUnaryNode = static_cast<RealUnary_Node const &>(other);
+    return op_ == otherUnaryNode.op_ && same(ope_, otherUnaryNode.ope_);
+}
+
+bool Error_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    return mix(h, value_) && mix(h, error_);
+}
+
+bool Error_Node::isIdentical(Node const &other) const {
+    auto &otherErrorNode = static_cast<Error_Node const &>(other);
+    return same(value_, otherErrorNode.value_) && same(error_, otherErrorNode.error_);
+}
+
+bool Floor_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    return mix(h, operand_);
+}
+
+bool Floor_Node::isIdentical(Node const &other) const {
+    return same(operand_, static_cast<Floor_Node const &>(other).operand_);
+}
+
+bool Max_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    for (auto &expr : operands_) {
+        if (!mix(h, expr))
+            return false;
+    }
+    return true;
+}
+
+bool Max_Node::isIdentical(Node const &other) const {
+    auto &otherMaxNode = static_cast<Max_Node const &>(other);
+    if (operands_.size() != otherMaxNode.operands_.size())
+        return false;
+    for (nat k = 0; k < operands_.size(); ++k) {
+        if (!same(operands_[k], otherMaxNode.operands_[k]))
+            return false;
+    }
+    return true;
+}
+
+bool Min_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    for (auto &expr : operands_) {
+        if (!mix(h, expr))
+            return false;
+    }
+    return true;
+}
+
+bool Min_Node::isIdentical(Node const &other) const {
+    auto &otherMinNode = static_cast<Min_Node const &>(other);
+    if (operands_.size() != otherMinNode.operands_.size())
+        return false;
+    for (nat k = 0; k < operands_.size(); ++k) {
+        if (!same(operands_[k], otherMinNode.operands_[k]))
+            return false;
+    }
+    return true;
+}
+
+bool RealBinary_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    mix(h, op_);
+    return mix(h, ope1_) && mix(h, ope2_);
+}
+
+bool RealBinary_Node::isIdentical(Node const &other) const {
+    auto &otherBinaryNode = static_cast<RealBinary_Node const &>(other);
+    return op_ == otherBinaryNode.op_ && same(ope1_, otherBinaryNode.ope1_) && same(ope2_, otherBinaryNode.ope2_);
+}
+
+bool RealPower_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    mix(h, n_);
+    return mix(h, ope_);
+}
+
+bool RealPower_Node::isIdentical(Node const &other) const {
+    auto &otherPowerNode = static_cast<RealPower_Node const &>(other);
+    return n_ == otherPowerNode.n_ && same(ope_, otherPowerNode.ope_);
+}
+
+bool RealLetin_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    mix(h, std::hash<std::string>()(name_));
+    return mix(h, let_) && mix(h, in_);
+}
+
+bool RealLetin_Node::isIdentical(Node const &other) const {
+    auto &otherLetinNode = static_cast<RealLetin_Node const &>(other);
+    return name_ == otherLetinNode.name_ && same(let_, otherLetinNode.let_) && same(in_, otherLetinNode.in_);
+}
+
+bool RealIfnz_Node::hash(std::size_t &h) const {
+    h = typeid(*this).hash_code();
+    return mix(h, cond_) && mix(h, lt_) && mix(h, gt_);
+}
+
+bool RealIfnz_Node::isIdentical(Node const &other) const {
+    auto &otherIfnzNode = static_cast<RealIfnz_Node const &>(other);
+    return same(cond_, otherIfnzNode.cond_) && same(lt_, otherIfnzNode.lt_) && same(gt_, otherIfnzNode.gt_);
+}
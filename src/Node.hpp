@@ -3,6 +3,8 @@
 
 #include "Real.hpp"
 
+#include <atomic>
+#include <memory>
 #include <typeinfo>
 
 namespace kodiak {
@@ -19,6 +21,10 @@ namespace kodiak {
         virtual ~Node() = default;
 
         bool operator==(const Node &other) const {
+            if (this == &other)
+                return true;
+            if (interned_ && other.interned_ && hash_ != other.hash_)
+                return false;
             return typeid(*this) == typeid(other) && isEqual(other);
         }
 
@@ -46,7 +52,19 @@ namespace kodiak {
 
         virtual bool isEqual(Node const &) const { return false; }
 
-        Node() : numOfVariables(0), realExpressionType_(kodiak::REAL), use_(0) {}
+        // Hash-consing (see Kodiak::set_hashconsing). A node can be interned when hash computes
+        // its structural hash, which requires interned operands. Variable names are not hashed,
+        // so equal nodes have equal hashes. Two nodes are identical when they have the same
+        // fields and share their operand nodes.
+        virtual bool hash(std::size_t &) const { return false; }
+        virtual bool isIdentical(Node const &) const { return false; }
+        static void mix(std::size_t &, const std::size_t);
+        static bool mix(std::size_t &, const Real &);
+        static bool same(const Real &, const Real &);
+        // Fresh serial number, which identifies a node in per-thread evaluation states
+        static std::size_t newSerial();
+
+        Node() : numOfVariables(0), realExpressionType_(kodiak::REAL), use_(0), hash_(0), interned_(false) {}
 
         virtual bool isVal() const {
             return false;
@@ -121,7 +139,9 @@ namespace kodiak {
         RealType realExpressionType_;
 
     private:
-        int use_;
+        std::atomic<int> use_; // Number of Reals that refer to this node
+        std::size_t hash_; // Structural hash of an interned node
+        bool interned_; // Node is in the hash-consing table
     };
 
     class RealVal_Node : public Node {
@@ -138,6 +158,8 @@ namespace kodiak {
         void print(std::ostream & = std::cout) const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const &other) const override {
             return this->val_ == static_cast<RealVal_Node const &>(other).val_;
         }
@@ -161,6 +183,8 @@ namespace kodiak {
         void print(std::ostream & = std::cout) const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const &other) const override {
             return this->var_ == static_cast<RealVar_Node const &>(other).var_;
         }
@@ -184,13 +208,15 @@ namespace kodiak {
         void print(std::ostream & = std::cout) const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const &other) const override {
              return this->name_ == static_cast<RealName_Node const &>(other).name_;
         };
 
     private:
         std::string name_; // variable name
-        nat db_; // De Bruijn index 
+        std::atomic<nat> slot_; // Index of the name in the last named box it was found in
         bool local_; // Is this variable local?
     };
 
@@ -208,6 +234,8 @@ namespace kodiak {
         void print(std::ostream & = std::cout) const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const &other) const override {
             auto &otherUnaryNode = static_cast<RealUnary_Node const &>(other);
             return this->op_  == otherUnaryNode.op_
@@ -233,6 +261,8 @@ namespace kodiak {
         bool isError() const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const &) const override;
 
     private:
@@ -253,6 +283,8 @@ namespace kodiak {
         bool isFloor() const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const & other) const override;
 
     private:
@@ -274,6 +306,8 @@ namespace kodiak {
         bool isMax() const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const &) const override;
 
     private:
@@ -296,6 +330,8 @@ namespace kodiak {
         bool isMin() const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const & other) const override;
 
     private:
@@ -316,6 +352,8 @@ namespace kodiak {
         void print(std::ostream & = std::cout) const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const &other) const override {
             auto &otherBinaryNode = static_cast<RealBinary_Node const &>(other);
             return this->op_   == otherBinaryNode.op_
@@ -343,6 +381,8 @@ namespace kodiak {
         void print(std::ostream & = std::cout) const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const &) const override { return false; }
 
     private:
@@ -364,8 +404,10 @@ namespace kodiak {
         void print(std::ostream & = std::cout) const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const &node) const override {
-            auto other = static_cast<RealLetin_Node const &>(node);
+            auto &other = static_cast<RealLetin_Node const &>(node);
             return this->name_ == other.name_ &&
                 this->let_ == other.let_ &&
                 this->in_ == other.in_;
@@ -391,6 +433,8 @@ namespace kodiak {
         void print(std::ostream & = std::cout) const override;
 
     protected:
+        bool hash(std::size_t &) const override;
+        bool isIdentical(Node const &) const override;
         bool isEqual(Node const &) const override { return false; }
 
     private:
@@ -405,11 +449,27 @@ namespace kodiak {
     typedef std::vector<MonoInfo> MonoInfos;
     typedef std::vector<Boxes> BCoeffs;
 
+    /* BernsteinPatches
+     * Univariate Bernstein coefficients of the terms of a polynomial in one variable,
+     * for the current interval of the variable and its ancestors in the search tree.
+     * The coefficients on a subinterval of a stored patch are obtained by de Casteljau
+     * subdivision, instead of being recomputed from the monomial form.
+     */
+    class BernsteinPatches {
+    public:
+        // Sets coeffs[j][0..deg] to the Bernstein coefficients of degree deg of the
+        // power of variable v in monomial j on X
+        void coefficients(const Monomials &, const nat v, const nat deg, const Interval &X, Boxes &coeffs);
+    private:
+        std::vector<std::pair<Interval, Boxes> > patches_; // Nested patches, outermost first
+    };
+    typedef std::vector<BernsteinPatches> BPatches;
+
     class Polynomial_Node : public Node {
         friend class Real;
     public:
 
-        Polynomial_Node() {
+        Polynomial_Node() : serial_(newSerial()) {
         }
         Polynomial_Node(const Monomials &, const Names &);
 
@@ -440,18 +500,19 @@ namespace kodiak {
         } // number of variables
         nat degree(const nat) const; // degree in a variable 
         //    void print_metadata(std::ostream & = std::cout) const;
-        bool diffConstants(NamedBox &);
-        void diffVariables(const Box &, NamedBox &);
-        Interval eval_bp(const Box &, NamedBox &);
-        Interval eval_poly(const Box &, NamedBox &) const;
-        bool isMonotone(const nat);
-        Monomials monoms_; // vector of monomials
-        Tuple degs_; // degree in each variable
-        Box B_; // current varbox
-        NamedBox C_; // current constbox
-        Box a_; // current coefficients
-        nat s_; // number of intervals in current box that have zero in their interior
-        BCoeffs b_; /* Tensor of Bernstein coefficients. k = nterms()
+        /* State
+         * Bernstein form of the polynomial on the box of the last enclosure computed by
+         * a thread. Each thread has its own states (see state), so evaluation does not
+         * modify the node and a Real can be evaluated concurrently.
+         */
+        struct State {
+            State() : s_(0) {
+            }
+            Box B_; // current varbox
+            NamedBox C_; // current constbox
+            Box a_; // current coefficients
+            nat s_; // number of intervals in current box that have zero in their interior
+            BCoeffs b_; /* Tensor of Bernstein coefficients. k = nterms()
                  { term 0:   b_0, ... , b_(degs_0) } 
 variable x0:     { ...            ...              } 
                  { term k-1: b_0, ... , b_(degs_0) }
@@ -460,12 +521,23 @@ variable x0:     { ...            ...              }
 variable x(n-1): { ...            ...                  } 
                  { term k-1: b_0, ... , b_(degs_(n-1)) }
     */
-        MonoInfos m_; // Monotonicity information per variable
-        Ints diff_; // Auxiliary array to compute differences betwen 
-        // new and current box
-        // diff[i] < 0  : varbox[i] == B_[i] 
-        // diff[i] == 0 : varbox[i] in B_[i]
-        // diff[i] > 0  : varbox[i] not in B[i] and varbox[i] != B_[i]
+            BPatches p_; // Bernstein patches per variable
+            MonoInfos m_; // Monotonicity information per variable
+            Ints diff_; // Auxiliary array to compute differences betwen 
+            // new and current box
+            // diff[i] < 0  : varbox[i] == B_[i] 
+            // diff[i] == 0 : varbox[i] in B_[i]
+            // diff[i] > 0  : varbox[i] not in B[i] and varbox[i] != B_[i]
+        };
+        std::shared_ptr<State> state() const; // State of the calling thread
+        bool diffConstants(const State &, NamedBox &) const;
+        void diffVariables(State &, const Box &, NamedBox &) const;
+        Interval eval_bp(State &, const Box &, NamedBox &) const;
+        Interval eval_poly(const Box &, NamedBox &) const;
+        bool isMonotone(State &, const nat) const;
+        Monomials monoms_; // vector of monomials
+        Tuple degs_; // degree in each variable
+        std::size_t serial_; // Identifies the states of the node
     };
 
     // Parameter is PolyExpr. Returns POLYNOMIAL
@@ -491,7 +563,7 @@ variable x(n-1): { ...            ...                  }
         friend class Real;
     public:
 
-        Rational_Node() {
+        Rational_Node() : serial_(newSerial()) {
         }
         Rational_Node(const Monomials &, const Monomials &, const Names &);
 
@@ -525,26 +597,34 @@ variable x(n-1): { ...            ...                  }
         // (max of numerator degree, denominator degree)
         // void print_metadata(std::ostream & = std::cout) const;
         //   moved to public, may wish to move back
-        bool diffConstants(NamedBox &);
-        void diffVariables(const Box &, NamedBox &);
-        Interval eval_bp(const Box &, NamedBox &);
+        // Bernstein form of the rational function on the box of the last enclosure computed
+        // by a thread (see Polynomial_Node::State)
+        struct State {
+            Box B_; // current varbox
+            NamedBox C_; // current constbox
+            Box num_a_; // current coefficients for numerator
+            Box den_a_; // current coefficients for denominator
+            BCoeffs num_b_; // Bernstein coefficients for numerator
+            BCoeffs den_b_; // Bernstein coefficients for denominator
+            BPatches num_p_; // Bernstein patches per variable for numerator
+            BPatches den_p_; // Bernstein patches per variable for denominator
+            // format as per Polynomial_Node
+            Ints diff_; // Auxiliary array to compute differences betwen 
+            // new and current box
+            // diff[i] < 0  : varbox[i] == B_[i] 
+            // diff[i] == 0 : varbox[i] in B_[i]
+            // diff[i] > 0  : varbox[i] not in B[i] and varbox[i] != B_[i]
+        };
+        std::shared_ptr<State> state() const; // State of the calling thread
+        bool diffConstants(const State &, NamedBox &) const;
+        void diffVariables(State &, const Box &, NamedBox &) const;
+        Interval eval_bp(State &, const Box &, NamedBox &) const;
         Interval eval_rat(const Box &, NamedBox &) const;
         Monomials num_monoms_; // vector of monomials for numerator
         Monomials den_monoms_; // vector of monomials for denominator
         Tuple degs_; // degree in each variable (max of numerator degree,
         //   denominator degree)
-        Box B_; // current varbox
-        NamedBox C_; // current constbox
-        Box num_a_; // current coefficients for numerator
-        Box den_a_; // current coefficients for denominator
-        BCoeffs num_b_; // Bernstein coefficients for numerator
-        BCoeffs den_b_; // Bernstein coefficients for denominator
-        // format as per Polynomial_Node
-        Ints diff_; // Auxiliary array to compute differences betwen 
-        // new and current box
-        // diff[i] < 0  : varbox[i] == B_[i] 
-        // diff[i] == 0 : varbox[i] in B_[i]
-        // diff[i] > 0  : varbox[i] not in B[i] and varbox[i] != B_[i]
+        std::size_t serial_; // Identifies the states of the node
     };
 
     Real rational(const Real &);
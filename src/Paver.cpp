@@ -1,4 +1,12 @@
 #include "Paver.hpp"
+#include "PavingIndex.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 
 using namespace kodiak;
 
@@ -27,7 +35,9 @@ void PavingStyle::set_color(const nat i, const std::string color) {
 
 void PrePaving::clear_boxes() {
     boxes_.clear();
+    roots_.clear();
     type_ = -1;
+    contracted_ = false;
 }
 
 void PrePaving::push_box(const nat i, const Box &box) {
@@ -57,6 +67,7 @@ void PrePaving::insert(const PrePaving &paving) {
             boxes_[i].push_back(paving.boxes(i)[k]);
         }
     }
+    roots_.insert(roots_.end(), paving.roots().begin(), paving.roots().end());
 }
 
 void Paving::gnuplot(const std::string filename,
@@ -422,6 +433,202 @@ void Paving::save(const std::string filename, const Names &titles, const Names &
     std::cout << "Kodiak (save): Boxes were saved in file " << os.str() << std::endl;
 }
 
+namespace {
+
+    const char PavingMagic[4] = {'K', 'P', 'A', 'V'};
+    const uint32_t ByteOrderMark = 0x01020304;
+
+    template <typename T>
+    void writeRaw(std::ofstream &f, const T &t) {
+        f.write(reinterpret_cast<const char *> (&t), sizeof (T));
+    }
+
+    // Bounds of the boxes are buffered, so that each box doesn't cost a call to write
+    void writeBoxes(std::ofstream &f, const Boxes &boxes, const nat nvars) {
+        std::vector<double> buffer;
+        buffer.reserve(2 * nvars);
+        for (nat k = 0; k < boxes.size(); ++k) {
+            buffer.clear();
+            for (nat v = 0; v < nvars; ++v) {
+                buffer.push_back(v < boxes[k].size() ? boxes[k][v].inf() : 0);
+                buffer.push_back(v < boxes[k].size() ? boxes[k][v].sup() : 0);
+            }
+            f.write(reinterpret_cast<const char *> (buffer.data()), buffer.size() * sizeof (double));
+        }
+    }
+
+    void corrupted(const std::string &filename, const std::string &what) {
+        std::ostringstream os;
+        os << "Kodiak (PavingFile): file \"" << filename << "\" " << what;
+        throw Growl(os.str());
+    }
+}
+
+const uint32_t PavingFile::VERSION;
+
+void Paving::save_binary(const std::string filename) const {
+    std::ofstream f(filename.c_str(), std::ofstream::out | std::ofstream::binary);
+    if (!f) {
+        std::ostringstream os;
+        os << "Kodiak (save_binary): file \"" << filename << "\" cannot be opened";
+        throw Growl(os.str());
+    }
+    nat n = nvars();
+    f.write(PavingMagic, sizeof (PavingMagic));
+    writeRaw(f, PavingFile::VERSION);
+    writeRaw(f, ByteOrderMark);
+    writeRaw(f, (uint32_t) n);
+    writeRaw(f, (uint32_t) ntypes());
+    writeRaw(f, (int32_t) type_);
+    writeRaw(f, (uint64_t) roots_.size());
+    for (nat i = 0; i < ntypes(); ++i)
+        writeRaw(f, (uint64_t) size(i));
+    for (nat v = 0; v < n; ++v) {
+        std::string name = varbox_.name(v);
+        writeRaw(f, (uint32_t) name.size());
+        f.write(name.data(), name.size());
+    }
+    static const char padding[8] = {0};
+    std::streamoff offset = f.tellp();
+    f.write(padding, (8 - offset % 8) % 8);
+    writeBoxes(f, Boxes(1, varbox_.box()), n);
+    for (nat i = 0; i < ntypes(); ++i)
+        writeBoxes(f, boxes_[i], n);
+    writeBoxes(f, roots_, n);
+    if (!f) {
+        std::ostringstream os;
+        os << "Kodiak (save_binary): file \"" << filename << "\" cannot be written";
+        throw Growl(os.str());
+    }
+}
+
+void Paving::load_binary(const std::string filename) {
+    *this = PavingFile(filename).paving();
+}
+
+PavingFile::PavingFile(const std::string filename) : data_(NULL), length_(0), nvars_(0), type_(-1),
+nroots_(0), roots_(NULL) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        corrupted(filename, "cannot be opened");
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 32) {
+        close(fd);
+        corrupted(filename, "is not a binary paving");
+    }
+    length_ = st.st_size;
+    void *data = mmap(NULL, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        corrupted(filename, "cannot be mapped in memory");
+    data_ = static_cast<const char *> (data);
+    try {
+        uint32_t version, bom, nvars, ntypes;
+        int32_t type;
+        std::memcpy(&version, data_ + 4, 4);
+        std::memcpy(&bom, data_ + 8, 4);
+        std::memcpy(&nvars, data_ + 12, 4);
+        std::memcpy(&ntypes, data_ + 16, 4);
+        std::memcpy(&type, data_ + 20, 4);
+        std::memcpy(&nroots_, data_ + 24, 8);
+        if (std::memcmp(data_, PavingMagic, 4) != 0)
+            corrupted(filename, "is not a binary paving");
+        if (bom != ByteOrderMark)
+            corrupted(filename, "was written with a different byte order");
+        if (version != VERSION)
+            corrupted(filename, "has an unsupported version");
+        nvars_ = nvars;
+        type_ = type;
+        size_t offset = 32;
+        if (offset + 8 * (size_t) ntypes > length_)
+            corrupted(filename, "is truncated");
+        sizes_.resize(ntypes);
+        for (nat i = 0; i < ntypes; ++i, offset += 8)
+            std::memcpy(&sizes_[i], data_ + offset, 8);
+        for (nat v = 0; v < nvars_; ++v) {
+            uint32_t len;
+            if (offset + 4 > length_)
+                corrupted(filename, "is truncated");
+            std::memcpy(&len, data_ + offset, 4);
+            offset += 4;
+            if (offset + len > length_)
+                corrupted(filename, "is truncated");
+            varbox_.push(std::string(data_ + offset, len));
+            offset += len;
+        }
+        offset += (8 - offset % 8) % 8;
+        if (offset > length_)
+            corrupted(filename, "is truncated");
+        // Mapped memory is page aligned, so bounds are aligned as doubles
+        size_t stride = 2 * sizeof (double) * nvars_;
+        uint64_t nboxes = 1; // Bounds of the variables
+        if (stride == 0) {
+            // Boxes of no variables take no space, so their number cannot be trusted
+            if (nroots_ > 0 || std::count(sizes_.begin(), sizes_.end(), 0) != (long) ntypes)
+                corrupted(filename, "is not a binary paving");
+        } else {
+            // Numbers of boxes are checked one by one against the room left, so that
+            // their sum cannot overflow
+            uint64_t room = (length_ - offset) / stride;
+            for (nat i = 0; i <= ntypes; ++i) {
+                uint64_t n = i < ntypes ? sizes_[i] : nroots_;
+                if (nboxes > room || n > room - nboxes)
+                    corrupted(filename, "is truncated");
+                nboxes += n;
+            }
+        }
+        if (offset + stride * nboxes != length_)
+            corrupted(filename, "is truncated");
+        const double *bounds = reinterpret_cast<const double *> (data_ + offset);
+        for (nat v = 0; v < nvars_; ++v)
+            varbox_.set(v, Interval(bounds[2 * v], bounds[2 * v + 1]));
+        bounds += 2 * nvars_;
+        boxes_.resize(ntypes);
+        for (nat i = 0; i < ntypes; ++i) {
+            boxes_[i] = bounds;
+            bounds += 2 * nvars_ * sizes_[i];
+        }
+        roots_ = bounds;
+    } catch (...) {
+        munmap(const_cast<char *> (data_), length_);
+        throw;
+    }
+}
+
+PavingFile::~PavingFile() {
+    munmap(const_cast<char *> (data_), length_);
+}
+
+Box PavingFile::box(const nat i, const uint64_t k) const {
+    const double *b = bounds(i, k);
+    Box box(nvars_);
+    for (nat v = 0; v < nvars_; ++v)
+        box[v] = Interval(b[2 * v], b[2 * v + 1]);
+    return box;
+}
+
+// Types are taken from the header, since types without boxes are saved too
+
+Paving PavingFile::paving() const {
+    Paving paving;
+    paving.set_ntypes(ntypes());
+    for (nat i = 0; i < ntypes(); ++i) {
+        paving.boxes(i).reserve(sizes_[i]);
+        for (uint64_t k = 0; k < sizes_[i]; ++k)
+            paving.push_box(i, box(i, k));
+    }
+    for (uint64_t k = 0; k < nroots_; ++k) {
+        const double *b = root(k);
+        Box box(nvars_);
+        for (nat v = 0; v < nvars_; ++v)
+            box[v] = Interval(b[2 * v], b[2 * v + 1]);
+        paving.push_root(box);
+    }
+    paving.set_varbox(varbox_);
+    paving.set_type(type_);
+    return paving;
+}
+
 #ifdef DEBUG
 void Paving::write(const std::string filename) {
     std::ostringstream os;
@@ -444,9 +651,11 @@ void Paving::read(const std::string filename) {
 // Compute the projection of a paving onto a smaller-dimensional space
 // (restricted list of variables). After eliminating the redundant
 // variables/intervals from all boxes, those boxes which are subsets
-// of any already in the result paving are excluded.
+// of another box of the same type are excluded (only the first one of
+// equal boxes is kept). Subsets are found with a PavingIndex, and
+// the queries are split among the given number of threads.
 
-Paving Paving::projection(const Names &names) {
+Paving Paving::projection(const Names &names, const nat threads) {
 
     Paving result;
     NamedBox varbox; // varbox for result, varbox_ for this paving
@@ -473,28 +682,50 @@ Paving Paving::projection(const Names &names) {
     x.resize(names.size());
     if (boxes_.size() == 0) return result;
     for (nat i = 0; i < boxes_.size(); ++i) { // iterate over types
-        if (boxes_[i].size() == 0) continue;
-        // add the first box
-        for (nat k = 0; k < names.size(); ++k) x[k] = boxes_[i][0][varlist[k]];
-        result.push_box(i, x);
-        if (boxes_[i].size() == 1) continue;
-        // add remaining boxes where necessary
-        for (nat j = 1; j < boxes_[i].size(); ++j) {
+        for (nat j = 0; j < boxes_[i].size(); ++j) {
             for (nat k = 0; k < names.size(); ++k) x[k] = boxes_[i][j][varlist[k]];
-            nat subset = 0; // is the jth box a subset of any box already
-            // pushed into the result paving?
-            for (nat jj = 0; jj < result.boxes(i).size(); ++jj) {
-                if (box_subset(result.boxes(i)[jj], x)) {
-                    subset = 1;
-                    break;
-                }
-            }
-            if (subset == 0) result.push_box(i, x);
+            result.push_box(i, x);
         }
     }
 
     for (nat i = 0; i < boxes_.size(); ++i) { // iterate over types
-        encluster(result.boxes(i));
+        Boxes &boxes = result.boxes(i);
+        if (boxes.size() < 2) continue;
+        std::vector<char> subset(boxes.size(), 0); // is the jth box a subset of another box?
+        {
+            PavingIndex index(result, Tuple(1, i));
+            auto work = [&](const nat first, const nat last) {
+                PavingIndex::Entries entries;
+                for (nat j = first; j < last; ++j) {
+                    entries.clear();
+                    index.intersects(boxes[j], entries);
+                    for (nat e = 0; e < entries.size(); ++e) {
+                        nat jj = entries[e].box;
+                        if (jj != j && box_subset(boxes[jj], boxes[j]) &&
+                            (jj < j || !box_subset(boxes[j], boxes[jj]))) {
+                            subset[j] = 1;
+                            break;
+                        }
+                    }
+                }
+            };
+            nat t = std::max(1u, std::min(threads, (nat) boxes.size() / 1024));
+            std::vector<std::thread> workers;
+            for (nat w = 1; w < t; ++w)
+                workers.emplace_back(work, boxes.size() * w / t, boxes.size() * (w + 1) / t);
+            work(0, boxes.size() / t);
+            for (nat w = 0; w < workers.size(); ++w)
+                workers[w].join();
+        }
+        nat n = 0;
+        for (nat j = 0; j < boxes.size(); ++j) {
+            if (!subset[j]) {
+                if (n != j) boxes[n] = boxes[j];
+                ++n;
+            }
+        }
+        boxes.resize(n);
+        encluster(boxes, threads);
     }
 
     result.set_type(type_);
@@ -502,6 +733,91 @@ Paving Paving::projection(const Names &names) {
 
 }
 
+const nat PavingSink::ROOT;
+
+void PavingSink::push_box(const nat i, const Box &box) {
+    wait();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (i >= sizes_.size())
+        sizes_.resize(i + 1, 0);
+    ++sizes_[i];
+    receive_box(i, box);
+}
+
+void PavingSink::push_root(const Box &box) {
+    wait();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++roots_;
+    receive_root(box);
+}
+
+FileSink::FileSink(const std::string filename) : file_(filename.c_str(), std::ofstream::out) {
+    if (!file_) {
+        std::ostringstream os;
+        os << "Kodiak (FileSink): file \"" << filename << "\" cannot be opened";
+        throw Growl(os.str());
+    }
+    file_ << std::setprecision(Kodiak::precision());
+}
+
+void FileSink::receive_box(const nat type, const Box &box) {
+    file_ << type;
+    for (nat v = 0; v < box.size(); ++v)
+        file_ << " " << box[v].inf() << " " << box[v].sup();
+    file_ << std::endl;
+}
+
+void FileSink::receive_root(const Box &box) {
+    file_ << "root";
+    for (nat v = 0; v < box.size(); ++v)
+        file_ << " " << box[v].inf() << " " << box[v].sup();
+    file_ << std::endl;
+}
+
+// A place of the queue is taken before the sink is locked, so that a full queue doesn't block
+// the other threads that push to the sink
+
+void QueueSink::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] {
+        return queue_.size() + reserved_ < capacity_ || closed_;
+    });
+    ++reserved_;
+}
+
+void QueueSink::receive_box(const nat type, const Box &box) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --reserved_;
+    if (closed_)
+        return;
+    queue_.push_back(std::make_pair(type, box));
+    cond_.notify_all();
+}
+
+void QueueSink::receive_root(const Box &box) {
+    receive_box(ROOT, box);
+}
+
+bool QueueSink::pop(nat &type, Box &box) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] {
+        return !queue_.empty() || closed_;
+    });
+    if (queue_.empty())
+        return false;
+    type = queue_.front().first;
+    box = queue_.front().second;
+    queue_.pop_front();
+    cond_.notify_all();
+    return true;
+}
+
+void QueueSink::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    cond_.notify_all();
+}
+
 PavingStyle Paver::default_style(const bool zoom, const bool filled) {
     PavingStyle pav = PavingStyle(zoom, filled);
     pav.push_titleColor("Certainly", "green");
@@ -511,7 +827,8 @@ PavingStyle Paver::default_style(const bool zoom, const bool filled) {
     return pav;
 }
 
-Paver::Paver(const std::string id) : flags_(0) {
+Paver::Paver(const std::string id) : flags_(0), newton_(false), sink_(NULL), budget_(0),
+stored_(std::make_shared<std::atomic<long> >(0)), peak_(0), coalesced_(0), summarized_(0), lostResolution_(0) {
     if (id == "") {
         std::ostringstream os;
         os << "P" << globalCounterOfSystemIDs++;
@@ -528,8 +845,18 @@ void Paver::pave(const SearchType search) {
     search_ = search;
     currentBoxCertainty_ = 0;
     paving_.clear_boxes();
+    // Clones made by the search share the counter of this search
+    stored_ = std::make_shared<std::atomic<long> >(0);
+    peak_ = 0;
+    coalesced_ = 0;
+    summarized_ = 0;
+    lostResolution_ = 0;
     Environment env {EmptyBBox, variablesEnclosures_.box(), EmptyNamedBox};
     branchAndBound(paving_, certainties, env);
+    if (sink_) {
+        stream(paving_);
+        paving_.clear_boxes();
+    }
     paving_.set_varbox(variablesEnclosures_);
     paving_.set_type(search_);
 }
@@ -539,16 +866,16 @@ void Paver::evaluate(PrePaving &paving, Ints &certainties, Environment &env) {
     //std::cout << "DirVars: " << dirvars() << std::endl;
     currentBoxCertainty_ = 1;
     nat numberOfFormulas = numberOfRelationalFormulas();
-    Box aBox = env.box;
+    // Formulas are evaluated on the box of the node, which they leave as they find it
+    Box &aBox = env.box;
     for (nat i = 0; i < numberOfFormulas; ++i) {
         bool isCurrentFormulaTrue = certainties[i] > 0;
         if (isCurrentFormulaTrue) continue;
 
         bool isSelectionNonEmpty = not dirvars().empty();
         if (isSelectionNonEmpty) {
-            Real currentFormulaLHS = relationalFormulas_[i].ope();
             nat mostRecentSelectionVariable = dirvars().back().var;
-            if (not currentFormulaLHS.hasVar(mostRecentSelectionVariable)
+            if (not formulaHasVar(i, mostRecentSelectionVariable)
                     /* TODO: Remove the following line and other users trivially true
                      * that seems useless:
                      * && where(dirvars(), dirvars().back().var) != EXTERIOR */
@@ -558,7 +885,8 @@ void Paver::evaluate(PrePaving &paving, Ints &certainties, Environment &env) {
                 continue;
             }
         }
-        evalGlobalDefinitions(); // TODO: Take out from the loop, since it should be constant or, if not, it would be asymmetric
+        // Only global definitions of the i-th formula whose variables changed are evaluated again
+        evalGlobalDefinitions(variablesEnclosures_.box(), i);
         certainties[i] = evalNthFormulaOnBox(i,aBox);
         // if i-th formula is certainly not true, conjunction of formulas is certainly not true
         if (certainties[i] == 0) {
@@ -579,10 +907,9 @@ void Paver::evaluate(PrePaving &paving, Ints &certainties, Environment &env) {
 void Paver::sos_eval(Interval &X, Ints &certainties, const Environment &env, const nat v) {
     evalGlobalDefinitions();
     X = Interval(0);
-    Box aBox = env.box;
     for (nat f = 0; f < numberOfRelationalFormulas(); ++f) {
-        if (certainties[f] < 0 && relationalFormulas_[f].ope().hasVar(v))
-            X += sqr(relationalFormulas_[f].ope().eval(aBox, globalDefinitionsEnclosures_));
+        if (certainties[f] < 0 && formulaHasVar(f, v))
+            X += sqr(relationalFormulas_[f].ope().eval(env.box, globalDefinitionsEnclosures_));
     }
 }
 
@@ -595,8 +922,7 @@ real Paver::minimumDiameterConsideredForNthVar(nat n) const {
 
 
 void Paver::select(DirVar &dirvar, Ints &certainties, Environment &env) {
-    Box aBox = env.box;
-    const nat numberOfVariables = aBox.size();
+    const nat numberOfVariables = env.box.size();
     for (nat variable = 0; variable < numberOfVariables; ++variable) {
         temp_.box[variable] = env.box[variable].approximatedMidpoint();
     }
@@ -612,7 +938,7 @@ void Paver::select(DirVar &dirvar, Ints &certainties, Environment &env) {
             temp_[variable] = env[variable];
             sos_eval(d_it, certainties, temp_, variable);
             real max_diff_it = d_it.diam();
-            if ((dirvar.var == aBox.size() && max_diff_it != 0) || max_diff_it > max_diff) {
+            if ((dirvar.var == numberOfVariables && max_diff_it != 0) || max_diff_it > max_diff) {
                 dirvar.var = variable;
                 max_diff = max_diff_it;
             }
@@ -621,25 +947,234 @@ void Paver::select(DirVar &dirvar, Ints &certainties, Environment &env) {
     }
 }
 
+namespace {
+
+    // Memory of a box, including its heap storage, if any
+    long boxBytes(const Box &box) {
+        long bytes = sizeof (Box);
+        if (box.capacity() > K_BOXDIM)
+            bytes += box.capacity() * sizeof (Interval);
+        return bytes;
+    }
+
+    long countBytes(const Boxes &boxes) {
+        long bytes = 0;
+        for (nat k = 0; k < boxes.size(); ++k)
+            bytes += boxBytes(boxes[k]);
+        return bytes;
+    }
+
+    long countBytes(const PrePaving &paving) {
+        long bytes = countBytes(paving.roots());
+        for (nat i = 0; i < paving.ntypes(); ++i)
+            bytes += countBytes(paving.boxes(i));
+        return bytes;
+    }
+
+    // Certainly-not boxes removed by the contraction of the box of a paving
+    PrePaving removedBoxes(const PrePaving &paving) {
+        PrePaving removed;
+        if (paving.contracted()) {
+            for (nat k = 0; k < paving.size(3); ++k)
+                removed.push_box(3, paving.boxes(3)[k]);
+        }
+        return removed;
+    }
+}
+
+// The box of the environment has been evaluated as possibly true. In full search, the
+// slabs removed by contraction are certainly-not boxes.
+
+bool Paver::contract(PrePaving &paving, Ints &, Environment &env) {
+    Box &original = original_;
+    original = env.box;
+    bool possible = !contraction() || contractFormulas(env);
+    int unique = -1;
+    if (possible && newton_) {
+        unique = newtonSystem(env.box);
+        possible = unique != 0;
+    }
+    long kept = countBytes(paving);
+    if (!possible) {
+        currentBoxCertainty_ = 0;
+        paving.clear_boxes();
+        if (search_ == FULL)
+            paving.push_box(3, original);
+        keep(paving, kept);
+        return false;
+    }
+    if (env.box == original) {
+        if (unique > 0)
+            paving.push_root(env.box);
+        keep(paving, kept);
+        return unique <= 0;
+    }
+    nat type = paving.type() >= 0 ? paving.type() : 1;
+    paving.clear_boxes();
+    if (search_ == FULL) {
+        Box slab = original;
+        for (nat v = 0; v < original.size(); ++v) {
+            if (original[v].inf() < env.box[v].inf()) {
+                slab[v] = Interval(original[v].inf(), env.box[v].inf());
+                paving.push_box(3, slab);
+            }
+            if (env.box[v].sup() < original[v].sup()) {
+                slab[v] = Interval(env.box[v].sup(), original[v].sup());
+                paving.push_box(3, slab);
+            }
+            slab[v] = env.box[v];
+        }
+    }
+    paving.push_box(type, env.box);
+    paving.set_contracted();
+    if (unique > 0)
+        paving.push_root(env.box);
+    keep(paving, kept);
+    return unique <= 0;
+}
+
+BranchAndBoundDF<Ints, PrePaving, Environment> *Paver::clone() const {
+    if (typeid(*this) != typeid(Paver))
+        return NULL;
+    Paver *paver = new Paver(*this);
+    paver->forkStatistics();
+    return paver;
+}
+
+// Clones share the bytes kept by the search, but count their own coalesced and summarized
+// boxes, which are added by merge
+
+void Paver::forkStatistics() {
+    coalesced_ = 0;
+    summarized_ = 0;
+}
+
+void Paver::merge(const BranchAndBoundDF<Ints, PrePaving, Environment> &worker) {
+    const Paver &paver = static_cast<const Paver &> (worker);
+    peak_ = std::max(peak_, paver.peak_);
+    coalesced_ += paver.coalesced_;
+    summarized_ += paver.summarized_;
+    lostResolution_ = std::max(lostResolution_, paver.lostResolution_);
+}
+
+// Best-first search explores first the boxes that are closest to certainty, i.e.,
+// those where more formulas are certainly true or true within eps
+
+real Paver::priority(const PrePaving &, const Ints &certainties, const Environment &) {
+    real closeness = 0;
+    for (nat i = 0; i < certainties.size(); ++i) {
+        if (certainties[i] > 0)
+            closeness += 1;
+        else if (certainties[i] == -2)
+            closeness += 0.5;
+    }
+    return closeness;
+}
+
+// Boxes of a streaming paving are pushed to the sink when they cannot be merged anymore, i.e.,
+// when they would be inserted in the paving of the parent node
+
+void Paver::stream(const PrePaving &paving) {
+    for (nat i = 0; i < paving.ntypes(); ++i) {
+        for (nat k = 0; k < paving.size(i); ++k)
+            sink_->push_box(i, paving.boxes(i)[k]);
+    }
+    for (nat k = 0; k < paving.roots().size(); ++k)
+        sink_->push_root(paving.roots()[k]);
+}
+
 void Paver::combine(PrePaving &paving, const DirVar &,
         const PrePaving &paving1) {
+    long kept = countBytes(paving) + countBytes(paving1);
+    PrePaving removed = removedBoxes(paving);
     paving.clear_boxes();
-    if (!paving1.empty())
-        paving.insert(paving1);
+    if (sink_) {
+        stream(removed);
+        stream(paving1);
+    } else {
+        if (!removed.empty())
+            paving.insert(removed);
+        if (!paving1.empty())
+            paving.insert(paving1);
+    }
+    keep(paving, kept);
 }
 
 void Paver::combine(PrePaving &paving, const DirVar &,
         const PrePaving &paving1, const PrePaving &paving2) {
-    // Paving type can only be POSSIBLE and contain only one box
+    long kept = countBytes(paving) + countBytes(paving1) + countBytes(paving2);
+    // Paving type can only be POSSIBLE and contain only one box. Contracted pavings
+    // don't consist of one box, and roots are not merged.
     if (paving1.type() == paving2.type() &&
-            paving1.type() >= 0)
+            paving1.type() >= 0 && !paving.contracted() &&
+            !paving1.contracted() && !paving2.contracted() &&
+            paving1.roots().empty() && paving2.roots().empty())
         paving.move_box_to(paving1.type());
     else {
+        PrePaving removed = removedBoxes(paving);
         paving.clear_boxes();
-        if (!paving1.empty())
-            paving.insert(paving1);
-        if (!paving2.empty())
-            paving.insert(paving2);
+        if (sink_) {
+            stream(removed);
+            stream(paving1);
+            stream(paving2);
+        } else {
+            if (!removed.empty())
+                paving.insert(removed);
+            if (!paving1.empty())
+                paving.insert(paving1);
+            if (!paving2.empty())
+                paving.insert(paving2);
+        }
+    }
+    keep(paving, kept);
+}
+
+// Boxes of a node are counted once it has been evaluated
+
+void Paver::accumulate(const PrePaving &paving) {
+    long bytes = countBytes(paving);
+    peak_ = std::max(peak_, (size_t) (*stored_ += bytes));
+}
+
+// The paving of a node replaces kept boxes, which may have been counted by a clone. It is
+// coalesced when the boxes kept by the search, in all threads, exceed the budget.
+
+void Paver::keep(PrePaving &paving, const long kept) {
+    long bytes = (*stored_ += countBytes(paving) - kept);
+    if (budget_ > 0 && (size_t) bytes > budget_ && !paving.contracted()) {
+        coalesce(paving);
+        bytes = *stored_;
+    }
+    peak_ = std::max(peak_, (size_t) bytes);
+}
+
+void Paver::coalesce(PrePaving &paving) {
+    for (nat i = 0; i < paving.ntypes(); ++i) {
+        nat size = paving.size(i);
+        if (size < 2)
+            continue;
+        long bytes = countBytes(paving.boxes(i));
+        encluster(paving.boxes(i));
+        coalesced_ += size - paving.size(i);
+        *stored_ -= bytes - countBytes(paving.boxes(i));
+    }
+    // Possibly boxes, i.e., types 1 and 2
+    for (nat i = 1; i < 3 && *stored_ > (long) budget_; ++i) {
+        nat size = paving.size(i);
+        if (size < 2)
+            continue;
+        Box box = paving.boxes(i)[0];
+        for (nat k = 1; k < size; ++k) {
+            const Box &b = paving.boxes(i)[k];
+            for (nat v = 0; v < box.size(); ++v)
+                box[v] = Interval(std::min(box[v].inf(), b[v].inf()), std::max(box[v].sup(), b[v].sup()));
+        }
+        for (nat v = 0; v < box.size(); ++v)
+            lostResolution_ = std::max(lostResolution_, box[v].diam());
+        long bytes = countBytes(paving.boxes(i));
+        paving.boxes(i).assign(1, box);
+        summarized_ += size;
+        *stored_ -= bytes - boxBytes(box);
     }
 }
 
@@ -668,8 +1203,22 @@ void Paver::print(std::ostream &os) const {
         }
         os << "<END DEBUG INFORMATION>" << std::endl << std::endl;
     }
-    for (nat i = 0; i < paving_.ntypes(); i++)
-        os << style.title(i) << ": " << paving_.size(i) << " boxes" << std::endl;
+    if (sink_) { // Boxes have been pushed to the sink
+        for (nat i = 0; i < sink_->ntypes(); i++)
+            os << style.title(i) << ": " << sink_->size(i) << " boxes" << std::endl;
+        if (newton_)
+            os << "Unique solutions: " << sink_->roots() << " boxes" << std::endl;
+    } else {
+        for (nat i = 0; i < paving_.ntypes(); i++)
+            os << style.title(i) << ": " << paving_.size(i) << " boxes" << std::endl;
+        if (newton_)
+            os << "Unique solutions: " << paving_.roots().size() << " boxes" << std::endl;
+    }
+    if (budget_ > 0) {
+        os << "Budget: " << budget_ << " bytes, Peak: " << peak_ << " bytes" << std::endl;
+        os << "Coalesced: " << coalesced_ << " boxes, Summarized: " << summarized_
+                << " boxes, Lost resolution: " << lostResolution_ << std::endl;
+    }
     print_info(os);
     os << std::endl;
     paving_.save(ID, style.titles());
@@ -1,6 +1,15 @@
 #ifndef KODIAK_PAVER
 #define KODIAK_PAVER
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <typeinfo>
+
 #include "LegacyBool.hpp"
 #include "BranchAndBoundDF.hpp"
 #include "System.hpp"
@@ -70,7 +79,7 @@ namespace kodiak {
 
     class PrePaving {
     public:
-        PrePaving() : type_(-1) {
+        PrePaving() : type_(-1), contracted_(false) {
         }
 
         int type() const {
@@ -80,6 +89,26 @@ namespace kodiak {
         bool empty() const {
             return boxes_.size() == 0;
         }
+
+        // A contracted paving is the box of a node narrowed by contraction, together with
+        // the certainly-not boxes removed from it in full search
+        bool contracted() const {
+            return contracted_;
+        }
+
+        void set_contracted(const bool contracted = true) {
+            contracted_ = contracted;
+        }
+
+        // Boxes of the paving that contain a unique solution of a square system of
+        // equations (see Paver::set_newton)
+        const Boxes &roots() const {
+            return roots_;
+        }
+
+        void push_root(const Box &box) {
+            roots_.push_back(box);
+        }
         void clear_boxes();
         void push_box(const nat, const Box &);
         void move_box_to(const nat);
@@ -89,6 +118,12 @@ namespace kodiak {
             return boxes_.size();
         }
 
+        // Makes room for boxes of n types, so that types without boxes are counted by ntypes
+        void set_ntypes(const nat n) {
+            if (n > boxes_.size())
+                boxes_.resize(n);
+        }
+
         nat size(const nat i) const {
             return i < boxes_.size() ? boxes_[i].size() : 0;
         }
@@ -116,6 +151,8 @@ namespace kodiak {
 
     protected:
         int type_;
+        bool contracted_; // See contracted
+        Boxes roots_; // See roots
 
         /* boxes_
          *
@@ -177,15 +214,220 @@ namespace kodiak {
         void save(const std::string, const Names &, const Names & = EmptyNames) const;
         void save(const std::string, const Names &, const bool) const;
 
+        // Binary format (see PavingFile). Boxes are written as raw doubles, so that they can be
+        // read back without parsing.
+        void save_binary(const std::string) const;
+        void load_binary(const std::string);
+
 #ifdef DEBUG
         void write(const std::string);
         void read(const std::string);
 #endif
-        Paving projection(const Names &);
+        Paving projection(const Names &, const nat threads = 1);
     private:
         NamedBox varbox_;
     };
 
+    /* PavingSink
+     *
+     * Receiver of the boxes of a paving (see Paver::set_sink). A box is pushed as soon as the
+     * search cannot merge it with a sibling anymore, so that the paving doesn't have to be kept
+     * in memory. Boxes are received one at a time, even when they come from several threads.
+     */
+
+    class PavingSink {
+    public:
+        // Type of the boxes that contain a unique solution, for sinks that receive them as boxes
+        static const nat ROOT = std::numeric_limits<nat>::max();
+
+        PavingSink() : roots_(0) {
+        }
+
+        virtual ~PavingSink() {
+        }
+
+        void push_box(const nat, const Box &);
+        void push_root(const Box &);
+
+        // Number of boxes of type i received so far
+        nat size(const nat i) const {
+            return i < sizes_.size() ? sizes_[i] : 0;
+        }
+
+        nat ntypes() const {
+            return sizes_.size();
+        }
+
+        // Number of boxes that contain a unique solution (see PrePaving::roots)
+        nat roots() const {
+            return roots_;
+        }
+
+    protected:
+        // Called before a box or a root is received, without holding the lock of the sink,
+        // e.g., to wait for room
+        virtual void wait() {
+        }
+
+        virtual void receive_box(const nat, const Box &) = 0;
+
+        virtual void receive_root(const Box &) {
+        }
+
+    private:
+        std::mutex mutex_;
+        std::vector<nat> sizes_;
+        nat roots_;
+    };
+
+    // Calls a function on each box, with its type. Roots have type ROOT.
+
+    class CallbackSink : public PavingSink {
+    public:
+        typedef std::function<void (const nat, const Box &) > Callback;
+
+        CallbackSink(const Callback &callback) : callback_(callback) {
+        }
+
+    protected:
+
+        void receive_box(const nat type, const Box &box) {
+            callback_(type, box);
+        }
+
+        void receive_root(const Box &box) {
+            callback_(ROOT, box);
+        }
+
+    private:
+        Callback callback_;
+    };
+
+    // Writes one box per line: its type followed by the lower and upper bounds of each variable.
+    // Boxes that contain a unique solution have type "root".
+
+    class FileSink : public PavingSink {
+    public:
+        FileSink(const std::string);
+
+    protected:
+        void receive_box(const nat, const Box &);
+        void receive_root(const Box &);
+
+    private:
+        std::ofstream file_;
+    };
+
+    // Bounded queue read by another thread. The search waits while the queue is full. Roots
+    // are queued with type ROOT.
+
+    class QueueSink : public PavingSink {
+    public:
+
+        QueueSink(const nat capacity) : capacity_(std::max(capacity, (nat) 1)), reserved_(0), closed_(false) {
+        }
+
+        // Waits for a box. Returns false when the queue has been closed and it is empty.
+        bool pop(nat &, Box &);
+
+        // No more boxes will be pushed, e.g., the search is over
+        void close();
+
+    protected:
+        void wait();
+        void receive_box(const nat, const Box &);
+        void receive_root(const Box &);
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::deque<std::pair<nat, Box> > queue_;
+        nat capacity_;
+        nat reserved_; // Places taken by boxes that are about to be received
+        bool closed_;
+    };
+
+    /* PavingFile
+     *
+     * Read-only view of a paving saved by Paving::save_binary. The file is mapped in memory and
+     * the bounds of the boxes are read in place.
+     *
+     * Format (version 1, native byte order):
+     *   char[4]  "KPAV"
+     *   uint32   version
+     *   uint32   byte order mark 0x01020304
+     *   uint32   number of variables n
+     *   uint32   number of types t
+     *   int32    type of the paving (see Paving::set_type)
+     *   uint64   number of roots
+     *   uint64   number of boxes of each type (t values)
+     *   names of the variables, each one as a uint32 length followed by its characters
+     *   padding to a multiple of 8 bytes
+     *   double   bounds of the variables, inf and sup of each one (2n values)
+     *   double   bounds of the boxes of each type, in the same layout as the variables
+     *   double   bounds of the roots
+     */
+
+    class PavingFile {
+    public:
+        static const uint32_t VERSION = 1;
+
+        PavingFile(const std::string);
+        ~PavingFile();
+
+        nat nvars() const {
+            return nvars_;
+        }
+
+        nat ntypes() const {
+            return sizes_.size();
+        }
+
+        int type() const {
+            return type_;
+        }
+
+        uint64_t size(const nat i) const {
+            return i < sizes_.size() ? sizes_[i] : 0;
+        }
+
+        uint64_t nroots() const {
+            return nroots_;
+        }
+
+        const NamedBox &varbox() const {
+            return varbox_;
+        }
+
+        // Bounds of the k-th box of type i: inf and sup of each variable
+        const double *bounds(const nat i, const uint64_t k) const {
+            return boxes_[i] + 2 * nvars_ * k;
+        }
+
+        const double *root(const uint64_t k) const {
+            return roots_ + 2 * nvars_ * k;
+        }
+
+        Box box(const nat, const uint64_t) const;
+
+        // Paving with the boxes of the file
+        Paving paving() const;
+
+    private:
+        PavingFile(const PavingFile &);
+        PavingFile &operator=(const PavingFile &);
+
+        const char *data_;
+        size_t length_;
+        nat nvars_;
+        int type_;
+        std::vector<uint64_t> sizes_;
+        uint64_t nroots_;
+        NamedBox varbox_;
+        std::vector<const double *> boxes_; // First bound of each type
+        const double *roots_;
+    };
+
     // STD: Search Certainly, AlmostCertainly, and Possibly boxes
     // FIRST: Search first box that is certainly or almost certainly (if tolerance is 0, search first that is certainly)
     // FULL: Seart standard + Certainly not
@@ -219,6 +461,62 @@ namespace kodiak {
             return flags_;
         }
 
+        // If newton is true, boxes of a system of n equations in n variables are narrowed by
+        // a Krawczyk (interval Newton) step after their evaluation. Boxes that contain a unique
+        // solution are not split further and are kept in the roots of the paving.
+        void set_newton(const bool newton = true) {
+            newton_ = newton;
+        }
+
+        bool newton() const {
+            return newton_;
+        }
+
+        // Streaming paving. If sink is not NULL, boxes are pushed to the sink instead of being
+        // kept in the answer, which is empty once the search is over. The sink is not owned by
+        // the paver.
+        void set_sink(PavingSink *sink = NULL) {
+            sink_ = sink;
+        }
+
+        PavingSink *sink() const {
+            return sink_;
+        }
+
+        // Memory budget of the paving, in bytes (0 means no budget). When the boxes kept by the
+        // search exceed the budget, the paving of the current node is coalesced: boxes of the
+        // same type that share a face are merged (see encluster), and if that isn't enough,
+        // the possibly boxes of each type are replaced by their hull. The paving is then
+        // coarser than the resolutions, which is reported by print.
+        void set_budget(const size_t bytes = 0) {
+            budget_ = bytes;
+        }
+
+        size_t budget() const {
+            return budget_;
+        }
+
+        // Largest number of bytes of the boxes kept by the search, including the heap storage
+        // of boxes of more than K_BOXDIM variables
+        size_t peak() const {
+            return peak_;
+        }
+
+        // Boxes removed by merging boxes that share a face
+        nat coalesced() const {
+            return coalesced_;
+        }
+
+        // Possibly boxes replaced by their hull
+        nat summarized() const {
+            return summarized_;
+        }
+
+        // Largest diameter of a hull of possibly boxes, 0 if none
+        real lost_resolution() const {
+            return lostResolution_;
+        }
+
         virtual void print(std::ostream & = std::cout) const;
 
         virtual void gnuplot(const std::string var1, const std::string var2) {
@@ -237,7 +535,25 @@ namespace kodiak {
         void combine(PrePaving &, const DirVar &, const PrePaving &);
         void combine(PrePaving &, const DirVar &, const PrePaving &, const PrePaving &);
         void select(DirVar &, Ints &, Environment &);
+        bool contract(PrePaving &, Ints &, Environment &);
+        BranchAndBoundDF<Ints, PrePaving, Environment> *clone() const;
+        void merge(const BranchAndBoundDF<Ints, PrePaving, Environment> &);
+        void forkStatistics();
+        real priority(const PrePaving &, const Ints &, const Environment &);
         real minimumDiameterConsideredForNthVar(nat n) const;
+        void stream(const PrePaving &);
+        void accumulate(const PrePaving &);
+        void keep(PrePaving &, const long);
+        void coalesce(PrePaving &);
+
+        // Children of a node start their evaluation from the enclosures of the node
+        virtual void descend() {
+            pushEnclosures();
+        }
+
+        virtual void ascend() {
+            popEnclosures();
+        }
 
         virtual bool local_exit(const PrePaving &) {
             return currentBoxCertainty_ != -1;
@@ -246,9 +562,28 @@ namespace kodiak {
         virtual bool global_exit(const PrePaving &) {
             return search_ == FIRST && (currentBoxCertainty_ == -2 || currentBoxCertainty_ > 0);
         }
+
+        virtual bool contracting() const {
+            return (contraction() || newton_) && numberOfRelationalFormulas() > 0;
+        }
+
+        // Narrows the box of the environment by forward-backward propagation of the formulas.
+        // Returns false if no point of the box satisfies them.
+        virtual bool contractFormulas(Environment &env) {
+            return contractSystem(env.box);
+        }
         virtual void sos_eval(Interval&, Ints &, const Environment &, const nat);
         Environment temp_; // Temporary box for internal computations
+        Box original_; // Box of the node being contracted, reused from node to node
         nat flags_; // Extra-certainty flags
+        bool newton_; // See set_newton
+        PavingSink *sink_; // See set_sink
+        size_t budget_; // See set_budget
+        std::shared_ptr<std::atomic<long> > stored_; // Bytes of the boxes kept by the search, shared by clones
+        size_t peak_; // See peak
+        nat coalesced_; // See coalesced
+        nat summarized_; // See summarized
+        real lostResolution_; // See lost_resolution
         SearchType search_; // Search type
 
         /*
@@ -273,6 +608,14 @@ namespace kodiak {
         virtual void select(DirVar &dirvar, Ints &certainties, Environment &box) {
             round_robin(dirvar, certainties, box);
         }
+
+        virtual BranchAndBoundDF<Ints, PrePaving, Environment> *clone() const {
+            if (typeid(*this) != typeid(LegacyPaver))
+                return NULL;
+            LegacyPaver *paver = new LegacyPaver(*this);
+            paver->forkStatistics();
+            return paver;
+        }
     };
 }
 
@@ -0,0 +1,191 @@
+#include "PavingIndex.hpp"
+
+#include <queue>
+
+using namespace kodiak;
+
+const nat PavingIndex::LEAF;
+
+PavingIndex::PavingIndex(const Paving &paving, const Tuple &types) : paving_(paving) {
+    Tuple ts = types;
+    if (ts.empty()) {
+        for (nat i = 0; i < paving.ntypes(); ++i)
+            ts.push_back(i);
+    }
+    for (nat t = 0; t < ts.size(); ++t) {
+        for (nat k = 0; k < paving.size(ts[t]); ++k) {
+            Entry e = {ts[t], k};
+            entries_.push_back(e);
+        }
+    }
+    if (entries_.empty())
+        return;
+    nodes_.reserve(2 * (entries_.size() / LEAF + 1));
+    nodes_.push_back(Node());
+    build(0, 0, entries_.size());
+}
+
+// Builds node n over entries_[lo, hi)
+
+void PavingIndex::build(const nat n, const nat lo, const nat hi) {
+    Box hull = box(entries_[lo]);
+    for (nat k = lo + 1; k < hi; ++k) {
+        const Box &b = box(entries_[k]);
+        for (nat v = 0; v < hull.size(); ++v)
+            hull[v] = Interval(std::min(hull[v].inf(), b[v].inf()), std::max(hull[v].sup(), b[v].sup()));
+    }
+    nodes_[n].hull = hull;
+    if (hi - lo <= LEAF) {
+        nodes_[n].first = lo;
+        nodes_[n].count = hi - lo;
+        return;
+    }
+    // Variable where the midpoints of the boxes are most spread out
+    nat dim = 0;
+    real spread = -1;
+    for (nat v = 0; v < hull.size(); ++v) {
+        real lb = box(entries_[lo])[v].mid();
+        real ub = lb;
+        for (nat k = lo + 1; k < hi; ++k) {
+            real m = box(entries_[k])[v].mid();
+            lb = std::min(lb, m);
+            ub = std::max(ub, m);
+        }
+        if (ub - lb > spread) {
+            spread = ub - lb;
+            dim = v;
+        }
+    }
+    nat mid = lo + (hi - lo) / 2;
+    std::nth_element(entries_.begin() + lo, entries_.begin() + mid, entries_.begin() + hi,
+            [this, dim](const Entry &a, const Entry &b) {
+                return box(a)[dim].mid() < box(b)[dim].mid();
+            });
+    nat c = nodes_.size();
+    nodes_.resize(c + 2);
+    nodes_[n].first = c;
+    nodes_[n].count = 0;
+    build(c, lo, mid);
+    build(c + 1, mid, hi);
+}
+
+namespace {
+
+    bool contains(const Box &box, const Point &p) {
+        for (nat v = 0; v < box.size(); ++v) {
+            if (p[v] < box[v].inf() || p[v] > box[v].sup())
+                return false;
+        }
+        return true;
+    }
+
+    bool intersects(const Box &box1, const Box &box2) {
+        for (nat v = 0; v < box1.size(); ++v) {
+            if (box1[v].sup() < box2[v].inf() || box2[v].sup() < box1[v].inf())
+                return false;
+        }
+        return true;
+    }
+}
+
+// Squared Euclidean distance between a box and a point
+
+real PavingIndex::distance2(const Box &box, const Point &p) {
+    real d2 = 0;
+    for (nat v = 0; v < box.size(); ++v) {
+        real d = p[v] < box[v].inf() ? box[v].inf() - p[v] : p[v] > box[v].sup() ? p[v] - box[v].sup() : 0;
+        d2 += d * d;
+    }
+    return d2;
+}
+
+void PavingIndex::contains(const Point &p, Entries &result) const {
+    result.clear();
+    if (nodes_.empty())
+        return;
+    if (p.size() != nodes_[0].hull.size())
+        throw Growl("Kodiak (PavingIndex): dimension of the point doesn't match the paving");
+    std::vector<nat> stack(1, 0);
+    while (!stack.empty()) {
+        const Node &node = nodes_[stack.back()];
+        stack.pop_back();
+        if (!::contains(node.hull, p))
+            continue;
+        if (node.count == 0) {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+            continue;
+        }
+        for (nat k = node.first; k < node.first + node.count; ++k) {
+            if (::contains(box(entries_[k]), p))
+                result.push_back(entries_[k]);
+        }
+    }
+}
+
+int PavingIndex::type(const Point &p) const {
+    Entries result;
+    contains(p, result);
+    int t = -1;
+    for (nat k = 0; k < result.size(); ++k) {
+        if (t < 0 || (int) result[k].type < t)
+            t = result[k].type;
+    }
+    return t;
+}
+
+void PavingIndex::intersects(const Box &b, Entries &result) const {
+    result.clear();
+    if (nodes_.empty())
+        return;
+    if (b.size() != nodes_[0].hull.size())
+        throw Growl("Kodiak (PavingIndex): dimension of the box doesn't match the paving");
+    std::vector<nat> stack(1, 0);
+    while (!stack.empty()) {
+        const Node &node = nodes_[stack.back()];
+        stack.pop_back();
+        if (!::intersects(node.hull, b))
+            continue;
+        if (node.count == 0) {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+            continue;
+        }
+        for (nat k = node.first; k < node.first + node.count; ++k) {
+            if (::intersects(box(entries_[k]), b))
+                result.push_back(entries_[k]);
+        }
+    }
+}
+
+// Best-first traversal: nodes are visited by increasing distance of their hulls to the point,
+// until that distance is greater than the distance to the closest box found so far
+
+bool PavingIndex::nearest(const Point &p, Entry &entry, real &distance) const {
+    if (nodes_.empty())
+        return false;
+    if (p.size() != nodes_[0].hull.size())
+        throw Growl("Kodiak (PavingIndex): dimension of the point doesn't match the paving");
+    typedef std::pair<real, nat> Candidate; // (squared distance, node)
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate> > queue;
+    queue.push(Candidate(distance2(nodes_[0].hull, p), 0));
+    real best = std::numeric_limits<real>::infinity();
+    while (!queue.empty() && queue.top().first < best) {
+        const Node &node = nodes_[queue.top().second];
+        queue.pop();
+        if (node.count == 0) {
+            queue.push(Candidate(distance2(nodes_[node.first].hull, p), node.first));
+            queue.push(Candidate(distance2(nodes_[node.first + 1].hull, p), node.first + 1));
+            continue;
+        }
+        for (nat k = node.first; k < node.first + node.count; ++k) {
+            real d2 = distance2(box(entries_[k]), p);
+            if (d2 < best) {
+                best = d2;
+                entry = entries_[k];
+            }
+        }
+    }
+    distance = std::sqrt(best);
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef KODIAK_PAVING_INDEX_HPP
+#define KODIAK_PAVING_INDEX_HPP
+
+#include "Paver.hpp"
+
+namespace kodiak {
+
+    /* PavingIndex
+     *
+     * Bounding volume hierarchy over the boxes of a paving. The index is bulk-loaded: boxes are
+     * recursively split at the median of their midpoints along the variable where the midpoints
+     * are most spread out, until at most LEAF boxes are left in a node. Each node keeps the
+     * smallest box that contains its boxes, so that queries only visit the nodes whose boxes
+     * may answer them. The index refers to the boxes of the paving, which must outlive it and
+     * must not be modified.
+     */
+
+    class PavingIndex {
+    public:
+        static const nat LEAF = 8;
+
+        // Box of the paving: its type and its index in boxes(type)
+        struct Entry {
+            nat type;
+            nat box;
+        };
+
+        typedef std::vector<Entry> Entries;
+
+        // Index of the boxes of the given types, or of all types when types is empty
+        PavingIndex(const Paving &, const Tuple &types = Tuple());
+
+        nat size() const {
+            return entries_.size();
+        }
+
+        const Box &box(const Entry &e) const {
+            return paving_.boxes(e.type)[e.box];
+        }
+
+        // Boxes that contain the point
+        void contains(const Point &, Entries &) const;
+
+        // Type of a box that contains the point, the smallest one when several boxes contain it
+        // (e.g., a certainly box shares a face with a possibly box), or -1 if there is none
+        int type(const Point &) const;
+
+        // Boxes that intersect the box
+        void intersects(const Box &, Entries &) const;
+
+        // Box closest to the point in Euclidean distance, which is set to the distance.
+        // Returns false when the index is empty.
+        bool nearest(const Point &, Entry &, real &distance) const;
+
+    private:
+        struct Node {
+            Box hull; // Smallest box that contains the boxes of the node
+            nat first; // Leaf: first entry, otherwise: first child (the second one is first + 1)
+            nat count; // Number of entries of a leaf, 0 otherwise
+        };
+
+        void build(const nat, const nat, const nat);
+        static real distance2(const Box &, const Point &);
+
+        const Paving &paving_;
+        Entries entries_;
+        std::vector<Node> nodes_; // Root is nodes_[0]
+    };
+}
+
+#endif // KODIAK_PAVING_INDEX_HPP
@@ -1,3 +1,5 @@
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include "Node.hpp"
@@ -6,6 +8,12 @@ using namespace kodiak;
 
 const Substitution kodiak::EmptySubstitution;
 
+namespace {
+    // Hash-consing table of interned nodes, indexed by structural hash
+    std::mutex internMutex;
+    std::unordered_multimap<std::size_t, Node *> internTable;
+}
+
 // --- Real  ---
 
 Real::Real(const Real &e) : node_(e.node_) {
@@ -14,11 +22,75 @@ Real::Real(const Real &e) : node_(e.node_) {
 }
 
 Real::Real(Node *node) {
-    if (node != NULL)
-        ++node->use_;
+    if (node != NULL) {
+        if (node->use_ == 0 && Kodiak::hashconsing())
+            node = intern(node);
+        else
+            ++node->use_;
+    }
     node_ = node;
 }
 
+// Returns the interned node identical to the fresh node, which is deleted, or interns the fresh node.
+// The reference count of the returned node is incremented.
+
+Node *Real::intern(Node *node) {
+    std::size_t h;
+    if (!node->hash(h)) {
+        ++node->use_;
+        return node;
+    }
+    Node *found = NULL;
+    {
+        std::lock_guard<std::mutex> lock(internMutex);
+        auto range = internTable.equal_range(h);
+        for (auto it = range.first; it != range.second && found == NULL; ++it) {
+            if (typeid(*it->second) == typeid(*node) && it->second->isIdentical(*node))
+                found = it->second;
+        }
+        if (found == NULL) {
+            node->hash_ = h;
+            node->interned_ = true;
+            ++node->use_;
+            internTable.insert(std::make_pair(h, node));
+            return node;
+        }
+        // Taken under the lock, so that a concurrent release cannot delete the node
+        ++found->use_;
+    }
+    delete node;
+    return found;
+}
+
+// Reference counts are atomic, so Reals can be shared between threads. The last reference to an
+// interned node is dropped under the lock, since the node can be found in the table until then.
+
+void Real::release(Node *node) {
+    if (!node->interned_) {
+        if (--node->use_ == 0)
+            delete node;
+        return;
+    }
+    int use = node->use_;
+    while (use > 1) {
+        if (node->use_.compare_exchange_weak(use, use - 1))
+            return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(internMutex);
+        if (--node->use_ > 0)
+            return;
+        auto range = internTable.equal_range(node->hash_);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == node) {
+                internTable.erase(it);
+                break;
+            }
+        }
+    }
+    delete node;
+}
+
 Real kodiak::val(const Interval &i) {
     return Real(new RealVal_Node(i));
 }
@@ -69,11 +141,8 @@ Real &Real::operator=(const Real &e) {
     if (this != &e) {
         if (!e.notAReal())
             ++e.node_->use_;
-        if (!notAReal()) {
-            --node_->use_;
-            if (node_->use_ == 0)
-                delete node_;
-        }
+        if (!notAReal())
+            release(node_);
         node_ = e.node_;
     }
     return *this;
@@ -1090,11 +1159,8 @@ std::string Real::toString() const {
 }
 
 Real::~Real() {
-    if (!notAReal()) {
-        --node_->use_;
-        if (node_->use_ <= 0)
-            delete node_;
-    }
+    if (!notAReal())
+        release(node_);
 }
 
 // --- Monomial ---
@@ -21,6 +21,8 @@ namespace kodiak {
     extern const Substitution EmptySubstitution;
 
     class Real {
+        friend class CompiledExpr;
+        friend class Node;
     public:
         Real(Node *);
         Real(const Real &);
@@ -150,6 +152,9 @@ namespace kodiak {
         ~Real();
 
     private:
+        static Node *intern(Node *);
+        static void release(Node *);
+
         Node *node_;
 
     };
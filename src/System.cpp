@@ -14,7 +14,7 @@ std::ostream &kodiak::operator<<(std::ostream &os, const Certainties &certs) {
 }
 
 System::System(const std::string id) :
-isConjunctive_(true), defaultEnclosureMethodTrueBernsteinFalseInterval_(false), absoluteToleranceForStoppingBranchAndBound_(0.1), granularityAkaDefaultResolutionForVariablesAsPercentageOfInitialBox_(0), varselect_(0) {
+isConjunctive_(true), defaultEnclosureMethodTrueBernsteinFalseInterval_(false), automaticDifferentiation_(false), contraction_(false), absoluteToleranceForStoppingBranchAndBound_(0.1), granularityAkaDefaultResolutionForVariablesAsPercentageOfInitialBox_(0), varselect_(0) {
     if (id == "") {
         std::ostringstream os;
         os << "F" << globalCounterOfSystemIDs++;
@@ -138,19 +138,50 @@ nat System::var(const std::string id, const Interval &lb, const Interval &ub) {
 void System::def(const std::string id, const Real &e, const bool bp) {
     Real r = e.index(variablesEnclosures_, constantsEnclosures_);
     r.checkIndexed(globalDefinitions_);
-    globalDefinitions_.push_back(make_pair(id, bp ? polynomial(r) : r));
-    globalDefinitionsEnclosures_.push(id);
+    addGlobalDefinition(id, bp ? polynomial(r) : r);
     for (nat v = 0; v < variablesEnclosures_.size(); ++v) {
         Real dx = (bp ? polynomial(r.deriv(v)) : r.deriv(v)).subs(defdx_);
         std::ostringstream os;
         os << "d" << id << "/d" << var_name(v);
         if (dx.isConst())
             defdx_[os.str()] = dx;
-        else {
-            globalDefinitions_.push_back(make_pair(os.str(), dx));
-            globalDefinitionsEnclosures_.push(os.str());
+        else
+            addGlobalDefinition(os.str(), dx);
+    }
+}
+
+void System::addGlobalDefinition(const std::string &id, const Real &e) {
+    VarSet vars(e.vars());
+    Tuple defs = globalDefinitionsOf(e);
+    for (nat k = 0; k < defs.size(); ++k)
+        vars.insert(globalDefinitionsVariables_[defs[k]]);
+    globalDefinitions_.push_back(make_pair(id, e));
+    compiledGlobalDefinitions_.push_back(CompiledExpr(e));
+    globalDefinitionsEnclosures_.push(id);
+    globalDefinitionsVariables_.push_back(vars);
+    staleGlobalDefinitions_.push_back(true);
+}
+
+// Global definitions that e refers to, directly or through other global definitions, in the order
+// in which they were defined
+
+Tuple System::globalDefinitionsOf(const Real &e) const {
+    NameSet names = e.locals();
+    Bools used(numberOfGlobalDefinitions(), false);
+    // Global definitions only refer to previous ones
+    for (nat f = numberOfGlobalDefinitions(); f > 0; --f) {
+        if (names.find(globalDefinitions_[f - 1].first) != names.end()) {
+            used[f - 1] = true;
+            const NameSet &locals = globalDefinitions_[f - 1].second.locals();
+            names.insert(locals.begin(), locals.end());
         }
     }
+    Tuple defs;
+    for (nat f = 0; f < used.size(); ++f) {
+        if (used[f])
+            defs.push_back(f);
+    }
+    return defs;
 }
 
 void System::defs(const NamedBox defbox, const std::vector< std::pair<std::string, Real> > defs) {
@@ -168,17 +199,62 @@ void System::defs(const NamedBox defbox, const std::vector< std::pair<std::strin
 void System::rel0(const Real &e, const RelType rel, const bool bp) {
     Real r = e.index(variablesEnclosures_, constantsEnclosures_);
     r.checkIndexed(globalDefinitions_);
-    relationalFormulas_.push_back(RelExpr(r, rel, bp, defdx_, r.closed() ? 0 : nvars()));
+    relationalFormulas_.push_back(RelExpr(r, rel, bp, defdx_, r.closed() ? 0 : nvars(), automaticDifferentiation_));
+    relationalFormulasDefinitions_.push_back(globalDefinitionsOf(r));
+    relationalFormulasVariables_.push_back(VarSet(r.vars()));
+    relationalFormulasOpen_.push_back(r.open());
     enclosureMethodForEachFormulaTrueBernsteinFalseInterval_.push_back(bp);
 }
 
 void System::evalGlobalDefinitions(Box &box) {
+    markGlobalDefinitions(box);
+    for (nat f = 0; f < numberOfGlobalDefinitions(); ++f)
+        evalGlobalDefinition(box, f);
+}
+
+void System::evalGlobalDefinitions(Box &box, const nat n) {
+    if (n >= relationalFormulasDefinitions_.size()) {
+        evalGlobalDefinitions(box);
+        return;
+    }
+    markGlobalDefinitions(box);
+    const Tuple &defs = relationalFormulasDefinitions_[n];
+    for (nat k = 0; k < defs.size(); ++k)
+        evalGlobalDefinition(box, defs[k]);
+}
+
+// Marks as stale the global definitions that depend on variables whose enclosures in box differ
+// from the box where global definitions were last evaluated
+
+void System::markGlobalDefinitions(const Box &box) {
+    if (globalDefinitionsBox_.size() != box.size()) {
+        globalDefinitionsBox_ = box;
+        staleGlobalDefinitions_.assign(numberOfGlobalDefinitions(), true);
+        return;
+    }
+    VarSet changed;
+    for (nat v = 0; v < box.size(); ++v) {
+        if (box[v].inf() != globalDefinitionsBox_[v].inf() || box[v].sup() != globalDefinitionsBox_[v].sup()) {
+            changed.insert(v);
+            globalDefinitionsBox_[v] = box[v];
+        }
+    }
+    if (changed.empty())
+        return;
     for (nat f = 0; f < numberOfGlobalDefinitions(); ++f) {
-        Interval X = globalDefinitions_[f].second.eval(box, globalDefinitionsEnclosures_, defaultEnclosureMethodTrueBernsteinFalseInterval_);
-        globalDefinitionsEnclosures_.set(f, X);
+        if (globalDefinitionsVariables_[f].intersects(changed))
+            staleGlobalDefinitions_[f] = true;
     }
 }
 
+void System::evalGlobalDefinition(Box &box, const nat f) {
+    if (!staleGlobalDefinitions_[f])
+        return;
+    Interval X = compiledGlobalDefinitions_[f].eval(box, globalDefinitionsEnclosures_, defaultEnclosureMethodTrueBernsteinFalseInterval_);
+    globalDefinitionsEnclosures_.set(f, X);
+    staleGlobalDefinitions_[f] = false;
+}
+
 int System::evalSystem(Box &box) {
     evalGlobalDefinitions();
     int cert = 1;
@@ -198,8 +274,7 @@ int System::evalSystem(Box &box, Certainties &certs, const DirVars &dirvars) {
     for (nat f = 0; f < numberOfRelationalFormulas(); ++f) {
         // if f-th formula is certainly true, don't check it again
         if (certs.get(f) > 0) continue;
-        if (!dirvars.empty() && relationalFormulas_[f].ope().closed() &&
-                relationalFormulas_[f].ope().isFresh(dirvars.back().var) &&
+        if (!dirvars.empty() && !formulaIsOpen(f) && !formulaHasVar(f, dirvars.back().var) &&
                 where(dirvars, dirvars.back().var) != EXTERIOR) {
             // top variable doesn't appear in f-th formula, don't check it again
             cert = (cert > 0 ? certs.get(f) : std::max(cert, certs.get(f)));
@@ -215,16 +290,161 @@ int System::evalSystem(Box &box, Certainties &certs, const DirVars &dirvars) {
     return certs.set(cert);
 }
 
+void System::pushEnclosures() {
+    for (nat f = 0; f < relationalFormulas_.size(); ++f)
+        relationalFormulas_[f].pushEnclosures();
+}
+
+void System::popEnclosures() {
+    for (nat f = 0; f < relationalFormulas_.size(); ++f)
+        relationalFormulas_[f].popEnclosures();
+}
+
 void System::sosSystem(Interval &X, Certainties &certs, const Box &box, const nat v) {
     X = Interval(0);
     if (certs.get() == -1) {
         for (nat f = 0; f < numberOfRelationalFormulas(); ++f) {
-            if (certs.get(f) == -1 && (relationalFormulas_[f].ope().open() || relationalFormulas_[f].ope().hasVar(v)))
+            if (certs.get(f) == -1 && (formulaIsOpen(f) || formulaHasVar(f, v)))
                 X += sqr(relationalFormulas_[f].ope().eval(box, globalDefinitionsEnclosures_));
         }
     }
 }
 
+bool System::contractSystem(Box &box) {
+    if (!isConjunctive_)
+        return true;
+    evalGlobalDefinitions(box);
+    // Propagation stops when no variable shrinks by more than 10%
+    for (nat pass = 0; pass < 8; ++pass) {
+        Box previous = box;
+        for (nat f = 0; f < relationalFormulas_.size(); ++f) {
+            if (!relationalFormulas_[f].contract(box, globalDefinitionsEnclosures_,
+                    enclosureMethodForEachFormulaTrueBernsteinFalseInterval_[f]))
+                return false;
+        }
+        bool progress = false;
+        for (nat v = 0; v < box.size() && !progress; ++v)
+            progress = box[v].diam() < 0.9 * previous[v].diam();
+        if (!progress)
+            break;
+    }
+    return true;
+}
+
+namespace {
+
+    typedef std::vector<std::vector<real> > Matrix;
+
+    // Inverts a by Gauss-Jordan elimination. Returns false if a is singular.
+    bool invert(Matrix &a) {
+        nat n = a.size();
+        Matrix inv(n, std::vector<real>(n, 0));
+        for (nat i = 0; i < n; ++i)
+            inv[i][i] = 1;
+        for (nat k = 0; k < n; ++k) {
+            nat p = k;
+            for (nat i = k + 1; i < n; ++i)
+                if (std::abs(a[i][k]) > std::abs(a[p][k]))
+                    p = i;
+            if (!(std::abs(a[p][k]) > 0))
+                return false;
+            std::swap(a[k], a[p]);
+            std::swap(inv[k], inv[p]);
+            real pivot = a[k][k];
+            for (nat j = 0; j < n; ++j) {
+                a[k][j] /= pivot;
+                inv[k][j] /= pivot;
+            }
+            for (nat i = 0; i < n; ++i) {
+                if (i == k || a[i][k] == 0)
+                    continue;
+                real factor = a[i][k];
+                for (nat j = 0; j < n; ++j) {
+                    a[i][j] -= factor * a[k][j];
+                    inv[i][j] -= factor * inv[k][j];
+                }
+            }
+        }
+        for (nat i = 0; i < n; ++i)
+            for (nat j = 0; j < n; ++j)
+                if (!std::isfinite(inv[i][j]))
+                    return false;
+        a.swap(inv);
+        return true;
+    }
+}
+
+// Krawczyk operator K(X) = m - Y f(m) + (I - Y J(X)) (X - m), where m is the midpoint of X,
+// J(X) encloses the Jacobian of the system on X, and Y is the inverse of the midpoint of J(X).
+// Every solution in X is in K(X), and if K(X) is in the interior of X, X has a unique solution.
+
+int System::newtonSystem(Box &box) {
+    const nat n = box.size();
+    if (n == 0 || relationalFormulas_.size() != n)
+        return -1;
+    for (nat f = 0; f < n; ++f) {
+        if (relationalFormulas_[f].op() != EQ)
+            return -1;
+    }
+    for (nat v = 0; v < n; ++v) {
+        if (std::isinf(box[v].inf()) || std::isinf(box[v].sup()))
+            return -1;
+    }
+    bool unique = false;
+    try {
+        // Iteration stops when no variable shrinks by more than 10%
+        for (nat pass = 0; pass < 8; ++pass) {
+            std::vector<Box> J(n);
+            evalGlobalDefinitions(box);
+            for (nat f = 0; f < n; ++f)
+                relationalFormulas_[f].gradient(box, globalDefinitionsEnclosures_, J[f], n,
+                    enclosureMethodForEachFormulaTrueBernsteinFalseInterval_[f]);
+            Box m(n);
+            for (nat v = 0; v < n; ++v) {
+                real mid = box[v].mid();
+                m[v] = Interval(mid, mid);
+            }
+            evalGlobalDefinitions(m);
+            Box fm(n);
+            for (nat f = 0; f < n; ++f)
+                fm[f] = relationalFormulas_[f].value(m, globalDefinitionsEnclosures_);
+            Matrix Y(n, std::vector<real>(n));
+            for (nat f = 0; f < n; ++f)
+                for (nat v = 0; v < n; ++v)
+                    Y[f][v] = J[f][v].mid();
+            if (!invert(Y))
+                break;
+            Box previous = box;
+            bool interior = true;
+            for (nat i = 0; i < n; ++i) {
+                Interval K = m[i];
+                for (nat f = 0; f < n; ++f)
+                    K -= Interval(Y[i][f], Y[i][f]) * fm[f];
+                for (nat v = 0; v < n; ++v) {
+                    Interval C = Interval(i == v ? 1 : 0);
+                    for (nat f = 0; f < n; ++f)
+                        C -= Interval(Y[i][f], Y[i][f]) * J[f][v];
+                    K += C * (previous[v] - m[v]);
+                }
+                interior = interior && previous[i].inf() < K.inf() && K.sup() < previous[i].sup();
+                real lo = std::max(box[i].inf(), K.inf());
+                real hi = std::min(box[i].sup(), K.sup());
+                if (lo > hi)
+                    return 0;
+                box[i] = Interval(lo, hi);
+            }
+            unique = unique || interior;
+            bool progress = false;
+            for (nat v = 0; v < n && !progress; ++v)
+                progress = box[v].diam() < 0.9 * previous[v].diam();
+            if (!progress)
+                break;
+        }
+    } catch (Growl const &) {
+    }
+    return unique ? 1 : -1;
+}
+
 void System::printSystem(std::ostream &os, const nat debug) const {
     os << "System: " << ID << std::endl;
     if (debug > 0) {
@@ -65,6 +65,31 @@ namespace kodiak {
 
         void setDefaultEnclosureMethodTrueForBernsteinAndFalseForIntervalArithmetic(const bool bp = true) {
             defaultEnclosureMethodTrueBernsteinFalseInterval_ = bp;
+            staleGlobalDefinitions_.assign(numberOfGlobalDefinitions(), true);
+        }
+
+        // If ad is true, the monotonicity tests compute the partial derivatives of constraints
+        // and objective functions by forward-mode automatic differentiation, in one evaluation
+        // per box, rather than building one symbolic derivative per variable. It applies to
+        // constraints and objective functions added afterwards.
+
+        void set_automatic_differentiation(const bool ad = true) {
+            automaticDifferentiation_ = ad;
+        }
+
+        bool automatic_differentiation() const {
+            return automaticDifferentiation_;
+        }
+
+        // If contraction is true, boxes are narrowed by forward-backward propagation of the
+        // constraints (HC4) after their evaluation and before being split.
+
+        void set_contraction(const bool contraction = true) {
+            contraction_ = contraction;
+        }
+
+        bool contraction() const {
+            return contraction_;
         }
 
         // Set default resolution for every variable, i.e., number in the interval [0,1]
@@ -286,7 +311,11 @@ namespace kodiak {
         void evalGlobalDefinitions() {
             evalGlobalDefinitions(variablesEnclosures_.box());
         };
+        // Evaluates the global definitions on box. A global definition is only evaluated again when
+        // the enclosure of a variable it depends on has changed since its last evaluation.
         void evalGlobalDefinitions(Box &);
+        // Same as above, but only for the global definitions that the n-th formula depends on
+        void evalGlobalDefinitions(Box &, const nat n);
 
         int evalSystem() {
             return evalSystem(variablesEnclosures_.box());
@@ -294,10 +323,37 @@ namespace kodiak {
         virtual int evalSystem(Box &);
         virtual int evalSystem(Box &, Certainties &, const DirVars &);
         void sosSystem(Interval &, Certainties &, const Box &, const nat);
+        // Narrows box by forward-backward propagation of the constraints. Returns false
+        // if no point of box satisfies the system.
+        bool contractSystem(Box &);
+        // Krawczyk step on a system of n equations in n variables. It narrows box and returns
+        // 0 if box has no solution, 1 if it has a unique solution, and -1 otherwise (or if the
+        // system is not square).
+        int newtonSystem(Box &);
+        // Enclosure cache of the formulas along the path of a branch and bound search. Evaluations
+        // of the formulas on sub-boxes of the box of the last push only recompute the subexpressions
+        // that depend on the variables that have been split or contracted since then.
+        void pushEnclosures();
+        void popEnclosures();
         void printSystem(std::ostream & = std::cout, const nat = 0) const;
 
 
     protected:
+        void addGlobalDefinition(const std::string &, const Real &);
+        Tuple globalDefinitionsOf(const Real &) const;
+        void markGlobalDefinitions(const Box &);
+        void evalGlobalDefinition(Box &, const nat);
+
+        // Incidence of the formulas on the variables, computed when the formulas are added. The
+        // variables of a formula don't include those of the global definitions it refers to.
+        bool formulaHasVar(const nat f, const nat v) const {
+            return relationalFormulasVariables_[f].find(v);
+        }
+
+        // A formula is open if it has local variables
+        bool formulaIsOpen(const nat f) const {
+            return relationalFormulasOpen_[f];
+        }
 
         int evalNthFormulaOnBox(nat n, Box &box) {
             assert (n < numberOfRelationalFormulas());
@@ -315,9 +371,18 @@ namespace kodiak {
         std::vector<RelExpr> relationalFormulas_;
         bool isConjunctive_;
         std::vector< std::pair<std::string, Real> > globalDefinitions_;
+        std::vector<CompiledExpr> compiledGlobalDefinitions_; // Evaluation tapes of globalDefinitions_
         NamedBox globalDefinitionsEnclosures_;
+        std::vector<VarSet> globalDefinitionsVariables_; // Variables of each global definition, including those of the definitions it refers to
+        std::vector<Tuple> relationalFormulasDefinitions_; // Global definitions each formula refers to, see globalDefinitionsOf
+        std::vector<VarSet> relationalFormulasVariables_; // Variables of each formula, see formulaHasVar
+        Bools relationalFormulasOpen_; // See formulaIsOpen
+        Box globalDefinitionsBox_; // Box where global definitions were last evaluated
+        Bools staleGlobalDefinitions_; // Global definitions whose enclosures don't correspond to globalDefinitionsBox_
         Substitution defdx_; // Constant substitutions of d(defs_)/dx 
         bool defaultEnclosureMethodTrueBernsteinFalseInterval_;
+        bool automaticDifferentiation_; // See set_automatic_differentiation
+        bool contraction_; // See set_contraction
 
         /*
          *  enclosureMethodForEachFormulaTrueBernsteinFalseInterval_
@@ -0,0 +1,103 @@
+#include "WorkStealingPool.hpp"
+
+using namespace kodiak;
+
+namespace {
+    // Pool and queue of the calling thread
+    thread_local const WorkStealingPool *currentPool = NULL;
+    thread_local nat currentQueue = 0;
+}
+
+WorkStealingPool::WorkStealingPool(const nat threads) : pending_(0), stop_(false) {
+    nat n = std::max(threads, 1u);
+    for (nat k = 0; k < n; ++k)
+        queues_.push_back(std::unique_ptr<Queue>(new Queue));
+    for (nat k = 1; k < n; ++k)
+        threads_.push_back(std::thread(&WorkStealingPool::work, this, k));
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    idle_.notify_all();
+    for (nat k = 0; k < threads_.size(); ++k)
+        threads_[k].join();
+}
+
+nat WorkStealingPool::current() const {
+    return currentPool == this ? currentQueue : 0;
+}
+
+WorkStealingPool::TaskPtr WorkStealingPool::spawn(const std::function<void()> &job) {
+    TaskPtr task = std::make_shared<Task>(job);
+    Queue &queue = *queues_[current()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++pending_;
+    }
+    idle_.notify_one();
+    return task;
+}
+
+void WorkStealingPool::wait(const TaskPtr &task) {
+    nat k = current();
+    while (!task->done()) {
+        if (!runOne(k))
+            std::this_thread::yield();
+    }
+    if (task->error_)
+        std::rethrow_exception(task->error_);
+}
+
+// Runs one task taken from the back of the k-th queue or, if that queue is empty,
+// from the front of any other queue. Returns false if no task was found.
+
+bool WorkStealingPool::runOne(const nat k) {
+    TaskPtr task;
+    {
+        Queue &queue = *queues_[k];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+    }
+    for (nat i = 1; !task && i < queues_.size(); ++i) {
+        Queue &victim = *queues_[(k + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task)
+        return false;
+    --pending_;
+    try {
+        task->job_();
+    } catch (...) {
+        task->error_ = std::current_exception();
+    }
+    task->job_ = std::function<void()>();
+    task->done_.store(true, std::memory_order_release);
+    return true;
+}
+
+void WorkStealingPool::work(const nat k) {
+    currentPool = this;
+    currentQueue = k;
+    while (!stop_) {
+        if (runOne(k))
+            continue;
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait_for(lock, std::chrono::milliseconds(1), [this] {
+            return stop_ || pending_ > 0;
+        });
+    }
+}
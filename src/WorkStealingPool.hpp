@@ -0,0 +1,84 @@
+#ifndef KODIAK_WORK_STEALING_POOL_HPP
+#define KODIAK_WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "types.hpp"
+
+namespace kodiak {
+
+    /* WorkStealingPool
+     *
+     * Fixed set of threads, each one with its own double-ended queue of tasks.
+     * A thread pushes and pops tasks at the back of its own queue (depth-first)
+     * and, when idle, steals from the front of the other queues (breadth-first).
+     * The thread that owns the pool takes part in the computation while it
+     * waits for its tasks, so a pool of n threads starts n-1 new threads.
+     */
+
+    class WorkStealingPool {
+    public:
+
+        class Task {
+        public:
+
+            explicit Task(const std::function<void()> &job) : job_(job), done_(false) {
+            }
+
+            bool done() const {
+                return done_.load(std::memory_order_acquire);
+            }
+
+        private:
+            friend class WorkStealingPool;
+            std::function<void()> job_;
+            std::exception_ptr error_; // Exception thrown by job_, if any
+            std::atomic<bool> done_;
+        };
+
+        typedef std::shared_ptr<Task> TaskPtr;
+
+        explicit WorkStealingPool(const nat threads);
+
+        ~WorkStealingPool();
+
+        nat size() const {
+            return queues_.size();
+        }
+
+        // Pushes a new task in the queue of the calling thread
+        TaskPtr spawn(const std::function<void()> &);
+
+        // Runs pending tasks until the given task is done. Rethrows the exception
+        // thrown by the task, if any.
+        void wait(const TaskPtr &);
+
+    private:
+
+        struct Queue {
+            std::mutex mutex;
+            std::deque<TaskPtr> tasks;
+        };
+
+        void work(const nat);
+        bool runOne(const nat);
+        nat current() const;
+
+        std::vector<std::unique_ptr<Queue> > queues_; // Queue 0 belongs to the owner of the pool
+        std::vector<std::thread> threads_;
+        std::atomic<nat> pending_; // Number of tasks waiting in the queues
+        std::atomic<bool> stop_;
+        std::mutex mutex_;
+        std::condition_variable idle_;
+    };
+}
+
+#endif // KODIAK_WORK_STEALING_POOL_HPP
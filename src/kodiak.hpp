@@ -22,6 +22,8 @@
 #include "MinMaxSystem.hpp"
 #include "NewMinMaxSystem.hpp"
 #include "Paver.hpp"
+#include "PavingIndex.hpp"
+#include "CompressedPaving.hpp"
 #include "NewPaver.hpp"
 #include "Bifurcation.hpp"
 
@@ -1,6 +1,10 @@
 #include "Node.hpp"
 #include "types.hpp"
 
+#include <atomic>
+#include <numeric>
+#include <thread>
+
 using namespace kodiak;
 
 // > 0 : relation wrt 0 is certainly true
@@ -63,6 +67,7 @@ nat NamedBox::push(const std::string name, const Interval &val) {
     }
     names_.push_back(name);
     box_.push_back(val);
+    relayout(size() - 1);
     return size() - 1;
 }
 
@@ -75,6 +80,7 @@ nat NamedBox::push(const std::string name, const Interval &lb, const Interval &u
     }
     names_.push_back(name);
     box_.push_back(Interval(lb.inf(), ub.sup()));
+    relayout(size() - 1);
     return size() - 1;
 }
 
@@ -137,6 +143,15 @@ nat NamedBox::var(const std::string nm) const {
     return size();
 }
 
+// Gives fresh layouts to the prefixes of names_ that end at index v or later
+
+void NamedBox::relayout(const nat v) {
+    static std::atomic<nat> layouts(0);
+    layouts_.resize(v);
+    for (nat k = v; k < names_.size(); ++k)
+        layouts_.push_back(++layouts);
+}
+
 std::string NamedBox::name(const nat v) const {
     if (Kodiak::debug() || v >= names_.size() || names_[v] == "")
         return var_name(v);
@@ -208,6 +223,7 @@ nat Kodiak::precision_ = K_PRECISION;
 std::string Kodiak::var_prefix_ = K_PREFIX;
 bool Kodiak::safe_input_ = true;
 bool Kodiak::debug_ = false;
+bool Kodiak::hashconsing_ = false;
 
 void Kodiak::set_precision(const nat precision) {
     precision_ = precision;
@@ -609,14 +625,101 @@ void kodiak::pack(Boxes &boxes, const Box &box) {
     boxes.push_back(box);
 }
 
-void kodiak::encluster(Boxes &boxes) {
-    Boxes aux;
-    for (nat i = 0; i < boxes.size(); ++i)
-        pack(aux, boxes[i]);
-    if (aux.size() < boxes.size()) {
-        encluster(aux);
+namespace {
+
+    // Sorts v with up to the given number of threads: chunks are sorted in parallel and then merged
+    template <typename T, typename Compare>
+    void parallelSort(std::vector<T> &v, Compare comp, const nat threads) {
+        size_t n = v.size();
+        size_t t = std::max((size_t) 1, std::min((size_t) threads, n / 4096));
+        if (t == 1) {
+            std::sort(v.begin(), v.end(), comp);
+            return;
+        }
+        std::vector<size_t> bounds(t + 1);
+        for (size_t k = 0; k <= t; ++k)
+            bounds[k] = n * k / t;
+        std::vector<std::thread> workers;
+        for (size_t k = 1; k < t; ++k)
+            workers.emplace_back([&v, &bounds, comp, k]() {
+                std::sort(v.begin() + bounds[k], v.begin() + bounds[k + 1], comp);
+            });
+        std::sort(v.begin(), v.begin() + bounds[1], comp);
+        for (size_t k = 0; k < workers.size(); ++k)
+            workers[k].join();
+        for (size_t width = 1; width < t; width *= 2) {
+            for (size_t k = 0; k + width < t; k += 2 * width)
+                std::inplace_merge(v.begin() + bounds[k], v.begin() + bounds[k + width],
+                        v.begin() + bounds[std::min(k + 2 * width, t)], comp);
+        }
     }
-    boxes = aux;
+
+    // True if both boxes have the same bounds in every variable but d
+    bool sameFaces(const Box &x, const Box &y, const nat d) {
+        for (nat v = 0; v < x.size(); ++v) {
+            if (v != d && (x[v].inf() != y[v].inf() || x[v].sup() != y[v].sup()))
+                return false;
+        }
+        return true;
+    }
+
+    // Merges boxes along variable d. Boxes with the same bounds in the other variables are sorted
+    // by their bounds in d, and each one is appended to a merged box whose upper bound in d is its
+    // lower bound, or dropped if it is equal to the previous one. Returns true if some boxes have
+    // been merged.
+    bool mergeAlong(Boxes &boxes, const nat d, const nat threads) {
+        std::vector<nat> order(boxes.size());
+        std::iota(order.begin(), order.end(), 0);
+        parallelSort(order, [&boxes, d](const nat a, const nat b) {
+            const Box &x = boxes[a];
+            const Box &y = boxes[b];
+            for (nat v = 0; v < x.size(); ++v) {
+                if (v == d)
+                    continue;
+                if (x[v].inf() != y[v].inf())
+                    return x[v].inf() < y[v].inf();
+                if (x[v].sup() != y[v].sup())
+                    return x[v].sup() < y[v].sup();
+            }
+            if (x[d].inf() != y[d].inf())
+                return x[d].inf() < y[d].inf();
+            return x[d].sup() < y[d].sup();
+        }, threads);
+        Boxes merged;
+        merged.reserve(boxes.size());
+        std::map<real, nat> ends; // Merged boxes of the current group, by their upper bound in d
+        for (nat k = 0; k < order.size(); ++k) {
+            const Box &box = boxes[order[k]];
+            bool same = k > 0 && sameFaces(boxes[order[k - 1]], box, d);
+            if (!same)
+                ends.clear();
+            std::map<real, nat>::iterator it = ends.find(box[d].inf());
+            if (it != ends.end()) {
+                nat m = it->second;
+                ends.erase(it);
+                merged[m][d] = Interval(merged[m][d].inf(), box[d].sup());
+                ends[box[d].sup()] = m;
+            } else if (!same || boxes[order[k - 1]][d].inf() != box[d].inf() ||
+                       boxes[order[k - 1]][d].sup() != box[d].sup()) {
+                ends[box[d].sup()] = merged.size();
+                merged.push_back(box);
+            }
+        }
+        bool changed = merged.size() < boxes.size();
+        boxes.swap(merged);
+        return changed;
+    }
+}
+
+// Boxes are merged along one variable at a time, until a round over all variables doesn't
+// merge any box. Each round takes O(n log n) time.
+
+void kodiak::encluster(Boxes &boxes, const nat threads) {
+    if (boxes.size() < 2)
+        return;
+    nat dims = boxes[0].size();
+    for (nat d = 0, idle = 0; idle < dims; d = (d + 1) % dims)
+        idle = mergeAlong(boxes, d, threads) ? 1 : idle + 1;
 }
 
 Interval kodiak::DoubleFExp(const Interval &interval) {
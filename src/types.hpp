@@ -5,25 +5,33 @@
 #define K_MAXCHOOSE 35 // Not to be changed unless definition of nat is changed
 #define K_PRECISION  8
 #define K_PREFIX    "x"
+#define K_BOXDIM    4  // Boxes of up to K_BOXDIM variables are stored without heap allocation.
+                       // Every box of a paving pays for K_BOXDIM intervals, so keep it small.
 
 #include <algorithm>
 #include <assert.h>
+#include <cstdint>
 #include <deque>
 #include <exception>
 #include <fstream>
 #include <interval/interval.hpp>
 #include <iostream>
 #include <iomanip>
+#include <iterator>
 #include <limits>
 #include <map>
+#include <new>
 #include <set>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <time.h>
 #include <vector>
 
 #ifdef DEBUG
 #include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_free.hpp>
+#include <boost/serialization/vector.hpp>
 #endif
 
 #include "Value.hpp"
@@ -107,6 +115,310 @@ namespace kodiak {
         bool linear_;
     };
 
+    /* SmallVector
+     *
+     * Sequence with the interface of std::vector that keeps up to N elements inline, i.e., in the
+     * object itself, and moves them to the heap when it grows beyond N. Copying, resizing and
+     * assigning a small vector of at most N elements never allocates memory.
+     */
+
+    template <typename T, nat N>
+    class SmallVector {
+    public:
+        typedef T value_type;
+        typedef nat size_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T &reference;
+        typedef const T &const_reference;
+        typedef T *pointer;
+        typedef const T *const_pointer;
+        typedef T *iterator;
+        typedef const T *const_iterator;
+
+        SmallVector() : data_(local()), size_(0), capacity_(N) {
+        }
+
+        explicit SmallVector(const nat n, const T &t = T()) : SmallVector() {
+            assign(n, t);
+        }
+
+        SmallVector(std::initializer_list<T> ts) : SmallVector() {
+            assign(ts.begin(), ts.end());
+        }
+
+        template <typename It, typename = typename std::iterator_traits<It>::iterator_category>
+        SmallVector(It first, It last) : SmallVector() {
+            assign(first, last);
+        }
+
+        SmallVector(const SmallVector &v) : SmallVector() {
+            assign(v.begin(), v.end());
+        }
+
+        SmallVector(SmallVector &&v) noexcept : SmallVector() {
+            steal(v);
+        }
+
+        ~SmallVector() {
+            clear();
+            release();
+        }
+
+        SmallVector &operator=(const SmallVector &v) {
+            if (this != &v)
+                assign(v.begin(), v.end());
+            return *this;
+        }
+
+        SmallVector &operator=(SmallVector &&v) noexcept {
+            if (this != &v) {
+                clear();
+                steal(v);
+            }
+            return *this;
+        }
+
+        SmallVector &operator=(std::initializer_list<T> ts) {
+            assign(ts.begin(), ts.end());
+            return *this;
+        }
+
+        void assign(const nat n, const T &t) {
+            T copy = t;
+            clear();
+            reserve(n);
+            for (; size_ < n; ++size_)
+                new (data_ + size_) T(copy);
+        }
+
+        template <typename It, typename = typename std::iterator_traits<It>::iterator_category>
+        void assign(It first, It last) {
+            nat n = std::distance(first, last);
+            // Elements are copied before clearing, in case they belong to this vector
+            if (n > capacity_) {
+                SmallVector v;
+                v.reserve(n);
+                for (; first != last; ++first)
+                    v.push_back(*first);
+                *this = std::move(v);
+                return;
+            }
+            nat k = 0;
+            for (; k < size_ && first != last; ++k, ++first)
+                data_[k] = *first;
+            for (; first != last; ++first, ++k)
+                new (data_ + k) T(*first);
+            for (nat i = k; i < size_; ++i)
+                data_[i].~T();
+            size_ = k;
+        }
+
+        nat size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        nat capacity() const {
+            return capacity_;
+        }
+
+        void reserve(const nat n) {
+            if (n <= capacity_)
+                return;
+            T *data = static_cast<T *> (::operator new(n * sizeof (T)));
+            for (nat k = 0; k < size_; ++k) {
+                new (data + k) T(std::move(data_[k]));
+                data_[k].~T();
+            }
+            release();
+            data_ = data;
+            capacity_ = n;
+        }
+
+        void resize(const nat n, const T &t = T()) {
+            if (n < size_) {
+                for (nat k = n; k < size_; ++k)
+                    data_[k].~T();
+                size_ = n;
+                return;
+            }
+            T copy = t;
+            if (n > capacity_)
+                reserve(std::max(n, 2 * capacity_));
+            for (; size_ < n; ++size_)
+                new (data_ + size_) T(copy);
+        }
+
+        void clear() noexcept {
+            for (nat k = 0; k < size_; ++k)
+                data_[k].~T();
+            size_ = 0;
+        }
+
+        void push_back(const T &t) {
+            if (size_ == capacity_) {
+                T copy = t;
+                reserve(2 * capacity_);
+                new (data_ + size_) T(std::move(copy));
+            } else
+                new (data_ + size_) T(t);
+            ++size_;
+        }
+
+        template <typename... Args>
+        void emplace_back(Args &&... args) {
+            push_back(T(std::forward<Args>(args)...));
+        }
+
+        void pop_back() {
+            data_[--size_].~T();
+        }
+
+        iterator insert(const_iterator pos, const T &t) {
+            return insert(pos, &t, &t + 1);
+        }
+
+        template <typename It, typename = typename std::iterator_traits<It>::iterator_category>
+        iterator insert(const_iterator pos, It first, It last) {
+            nat k = pos - data_;
+            SmallVector tail(data_ + k, data_ + size_);
+            SmallVector ins(first, last);
+            resize(k);
+            reserve(k + ins.size() + tail.size());
+            for (nat i = 0; i < ins.size(); ++i)
+                push_back(ins[i]);
+            for (nat i = 0; i < tail.size(); ++i)
+                push_back(tail[i]);
+            return data_ + k;
+        }
+
+        iterator erase(const_iterator pos) {
+            return erase(pos, pos + 1);
+        }
+
+        iterator erase(const_iterator first, const_iterator last) {
+            nat k = first - data_;
+            nat n = last - first;
+            for (nat i = k; i + n < size_; ++i)
+                data_[i] = std::move(data_[i + n]);
+            resize(size_ - n);
+            return data_ + k;
+        }
+
+        void swap(SmallVector &v) {
+            SmallVector tmp(std::move(v));
+            v = std::move(*this);
+            *this = std::move(tmp);
+        }
+
+        T &operator[](const nat k) {
+            return data_[k];
+        }
+
+        const T &operator[](const nat k) const {
+            return data_[k];
+        }
+
+        T &at(const nat k) {
+            if (k >= size_)
+                throw std::out_of_range("SmallVector::at");
+            return data_[k];
+        }
+
+        const T &at(const nat k) const {
+            if (k >= size_)
+                throw std::out_of_range("SmallVector::at");
+            return data_[k];
+        }
+
+        T &front() {
+            return data_[0];
+        }
+
+        const T &front() const {
+            return data_[0];
+        }
+
+        T &back() {
+            return data_[size_ - 1];
+        }
+
+        const T &back() const {
+            return data_[size_ - 1];
+        }
+
+        T *data() {
+            return data_;
+        }
+
+        const T *data() const {
+            return data_;
+        }
+
+        iterator begin() {
+            return data_;
+        }
+
+        iterator end() {
+            return data_ + size_;
+        }
+
+        const_iterator begin() const {
+            return data_;
+        }
+
+        const_iterator end() const {
+            return data_ + size_;
+        }
+
+        bool operator==(const SmallVector &v) const {
+            return size_ == v.size_ && std::equal(begin(), end(), v.begin());
+        }
+
+        bool operator!=(const SmallVector &v) const {
+            return !(*this == v);
+        }
+
+    private:
+        T *local() noexcept {
+            return reinterpret_cast<T *> (local_);
+        }
+
+        // Frees the heap storage, if any. Elements must have been destroyed.
+        void release() noexcept {
+            if (data_ != local())
+                ::operator delete(data_);
+            data_ = local();
+            capacity_ = N;
+        }
+
+        // Takes the elements of v, which is left empty. This vector must be empty.
+        void steal(SmallVector &v) noexcept {
+            if (v.data_ != v.local()) {
+                release();
+                data_ = v.data_;
+                size_ = v.size_;
+                capacity_ = v.capacity_;
+                v.data_ = v.local();
+                v.size_ = 0;
+                v.capacity_ = N;
+                return;
+            }
+            for (nat k = 0; k < v.size_; ++k)
+                new (data_ + k) T(std::move(v.data_[k]));
+            size_ = v.size_;
+            v.clear();
+        }
+
+        T *data_; // Either local_ or heap storage
+        nat size_;
+        nat capacity_;
+        alignas(T) unsigned char local_[N * sizeof (T)];
+    };
+
     typedef Bag<nat> VarBag;
     typedef std::vector<real> Point;
     typedef std::set<std::string> NameSet;
@@ -119,6 +431,67 @@ namespace kodiak {
     extern const Names EmptyNames;
     extern const NameSet EmptyNameSet;
 
+    /* VarSet
+     *
+     * Set of variable indices stored as a bitset, one bit per variable. Membership, union and
+     * intersection tests cost a few word operations, instead of the map lookups of a VarBag.
+     */
+
+    class VarSet {
+    public:
+
+        VarSet() {
+        }
+
+        VarSet(const VarBag &vars) {
+            for (VarBag::iterator it = vars.begin(); it != vars.end(); ++it)
+                insert(it->first);
+        }
+
+        bool empty() const {
+            for (nat k = 0; k < words_.size(); ++k)
+                if (words_[k] != 0) return false;
+            return true;
+        }
+
+        bool find(const nat v) const {
+            return v / 64 < words_.size() && ((words_[v / 64] >> (v % 64)) & 1);
+        }
+
+        void insert(const nat v) {
+            if (v / 64 >= words_.size())
+                words_.resize(v / 64 + 1, 0);
+            words_[v / 64] |= (uint64_t) 1 << (v % 64);
+        }
+
+        void insert(const VarSet &s) {
+            if (s.words_.size() > words_.size())
+                words_.resize(s.words_.size(), 0);
+            for (nat k = 0; k < s.words_.size(); ++k)
+                words_[k] |= s.words_[k];
+        }
+
+        bool intersects(const VarSet &s) const {
+            nat n = std::min(words_.size(), s.words_.size());
+            for (nat k = 0; k < n; ++k)
+                if (words_[k] & s.words_[k]) return true;
+            return false;
+        }
+
+        // Variables of the set in increasing order
+        Tuple elements() const {
+            Tuple vars;
+            for (nat k = 0; k < words_.size(); ++k) {
+                for (nat b = 0; b < 64; ++b)
+                    if ((words_[k] >> b) & 1) vars.push_back(64 * k + b);
+            }
+            return vars;
+        }
+
+    private:
+        std::vector<uint64_t> words_;
+    };
+
     // This class implments Steinhaus-Johnson-Trotter_algorithm for generating
     // permutations of alternating sign.
     // It closely follows the description in http://pastebin.com/fmuu3nGh.
@@ -262,7 +635,7 @@ namespace kodiak {
         }
     }
 
-    typedef std::vector<Interval> Box;
+    typedef SmallVector<Interval, K_BOXDIM> Box;
     extern const Box EmptyBox;
 
     typedef std::vector<Box> Boxes;
@@ -295,6 +668,8 @@ namespace kodiak {
         void serialize(Archive &ar, const unsigned int) {
             ar & BOOST_SERIALIZATION_NVP(box_);
             ar & BOOST_SERIALIZATION_NVP(names_);
+            if (layouts_.size() != names_.size())
+                relayout(0);
         }
 #endif
         // Push a new variable
@@ -321,11 +696,14 @@ namespace kodiak {
         void pop() {
             names_.pop_back();
             box_.pop_back();
+            layouts_.pop_back();
         }
 
         void insert(const NamedBox &nbox) {
+            nat v = size();
             box_.insert(box_.end(), nbox.box().begin(), nbox.box().end());
             names_.insert(names_.end(), nbox.names().begin(), nbox.names().end());
+            relayout(v);
         }
 
         bool empty() const {
@@ -335,6 +713,7 @@ namespace kodiak {
         void clear() {
             names_.clear();
             box_.clear();
+            layouts_.clear();
         }
 
         nat size() const {
@@ -342,11 +721,20 @@ namespace kodiak {
         }
 
         void resize(nat v) {
+            nat n = std::min(v, size());
             box_.resize(v);
             names_.resize(v);
+            relayout(n);
         }
         nat var(const std::string) const;
 
+        // Identifier of the sequence of names in the box. Boxes with the same layout have the same
+        // names at the same indices, so an index found by var remains valid while the layout doesn't
+        // change. Pushing a name changes the layout and popping it restores the previous one.
+        nat layout() const {
+            return layouts_.empty() ? 0 : layouts_.back();
+        }
+
         Interval val(const nat v) const {
             return box_[v];
         }
@@ -363,18 +751,17 @@ namespace kodiak {
         Box &box() {
             return box_;
         }
-
-        Names &names() {
-            return names_;
-        }
         void print(std::ostream & = std::cout, const nat = 0, const nat = 0) const;
 
         bool operator==(const NamedBox &another) const {
             return this->box() == another.box();
         }
     private:
+        void relayout(const nat);
+
         Box box_;
         Names names_;
+        std::vector<nat> layouts_; // Layout of each prefix of names_
     };
 
     extern const NamedBox EmptyNamedBox;
@@ -411,6 +798,15 @@ namespace kodiak {
         static void set_debug(const bool b = true) {
             debug_ = b;
         }
+
+        static bool hashconsing() {
+            return hashconsing_;
+        }
+
+        // When set, structurally equal expressions share their nodes, except polynomials and rationals
+        static void set_hashconsing(const bool b = true) {
+            hashconsing_ = b;
+        }
         static nat factorial(nat);
         static nat choose(nat, nat);
     private:
@@ -418,6 +814,7 @@ namespace kodiak {
         static std::string var_prefix_;
         static bool safe_input_;
         static bool debug_;
+        static bool hashconsing_;
         static nat factorial_[K_MAXFACT];
         static nat choose_[K_MAXCHOOSE][K_MAXCHOOSE];
 
@@ -494,7 +891,9 @@ namespace kodiak {
     bool overlap(const Box &, const Box &);
     void hull(Box &, const Box &);
     void pack(Boxes &, const Box &);
-    void encluster(Boxes &);
+    // Merges boxes that share a face, or that are equal, until no more boxes can be merged.
+    // Sorting may use up to the given number of threads.
+    void encluster(Boxes &, const nat threads = 1);
     void save_boxes(std::ofstream &, const Boxes &, const Tuple &, const nat);
     void gnuplot_boxes(std::ofstream &, const Boxes &, const nat, const nat,
             const nat);
@@ -517,6 +916,14 @@ namespace kodiak {
         os << postfix;
     }
 
+    template <typename T, nat N>
+    void print(const SmallVector<T, N> &v, std::ostream &os = std::cout,
+            const std::string prefix = "(",
+            const std::string midfix = ", ",
+            const std::string postfix = ")") {
+        kodiak::print(std::vector<T>(v.begin(), v.end()), os, prefix, midfix, postfix);
+    }
+
     template <typename T>
     void print(const std::set<T> &s, std::ostream &os = std::cout) {
         os << "{ ";
@@ -575,6 +982,12 @@ namespace kodiak {
         return os;
     }
 
+    template <typename T, nat N>
+    std::ostream &operator<<(std::ostream &os, const SmallVector<T, N> &vector) {
+        kodiak::print(vector, os);
+        return os;
+    }
+
     template <typename T>
     std::ostream &operator<<(std::ostream &os, const std::set<T> &set) {
         kodiak::print(set, os);
@@ -594,4 +1007,31 @@ namespace kodiak {
 
     Box &operator<<(Box &, const Interval &);
 }
+
+#ifdef DEBUG
+namespace boost {
+    namespace serialization {
+
+        // Small vectors are serialized as vectors
+
+        template<class Archive, typename T, kodiak::nat N>
+        void save(Archive &ar, const kodiak::SmallVector<T, N> &v, const unsigned int) {
+            std::vector<T> elems(v.begin(), v.end());
+            ar << BOOST_SERIALIZATION_NVP(elems);
+        }
+
+        template<class Archive, typename T, kodiak::nat N>
+        void load(Archive &ar, kodiak::SmallVector<T, N> &v, const unsigned int) {
+            std::vector<T> elems;
+            ar >> BOOST_SERIALIZATION_NVP(elems);
+            v.assign(elems.begin(), elems.end());
+        }
+
+        template<class Archive, typename T, kodiak::nat N>
+        void serialize(Archive &ar, kodiak::SmallVector<T, N> &v, const unsigned int version) {
+            split_free(ar, v, version);
+        }
+    }
+}
+#endif
 #endif // KODIAK_TYPES